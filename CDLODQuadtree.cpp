@@ -0,0 +1,210 @@
+#include "CDLODQuadtree.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Fraction of a level's range after which its vertices start morphing towards the parent's grid
+static const float morphStartRatio = 0.7f;
+
+CDLODQuadtree::CDLODQuadtree(float extent, int levels, int patchResolution, float finestRange)
+        : extent(extent), center(0.0f), levels(std::min(std::max(levels, 1), maxLevels)), patchResolution(patchResolution),
+          cameraPosition(0.0f), minHeight(0.0f), maxHeight(0.0f), vao(0), patchVBO(0), patchEBO(0), instanceVBO(0),
+          patchIndexCount(0), instanceCapacity(0) {
+    if (patchResolution % 2 != 0) {
+        std::cerr << "CDLOD patch resolution must be even, using " << patchResolution + 1 << std::endl;
+        this->patchResolution = patchResolution + 1;
+    }
+
+    float previous = 0.0f;
+    float range = finestRange;
+    for (int level = 0; level < this->levels; ++level) {
+        ranges.push_back(range);
+        morphRanges.emplace_back(previous + (range - previous) * morphStartRatio, range);
+        previous = range;
+        range *= 2.0f;
+    }
+}
+
+void CDLODQuadtree::setup() {
+    // Step 1: One (patchResolution + 1)^2 grid over [0, 1]^2, shared by every node
+    int side = patchResolution + 1;
+    std::vector<GLfloat> vertices;
+    vertices.reserve(side * side * 2);
+    for (int z = 0; z < side; ++z) {
+        for (int x = 0; x < side; ++x) {
+            vertices.push_back(x / (float) patchResolution);
+            vertices.push_back(z / (float) patchResolution);
+        }
+    }
+
+    std::vector<GLushort> indices;
+    indices.reserve(patchResolution * patchResolution * 6);
+    for (int z = 0; z < patchResolution; ++z) {
+        for (int x = 0; x < patchResolution; ++x) {
+            indices.push_back(z * side + x);           // Top left
+            indices.push_back((z + 1) * side + x);     // Bottom left
+            indices.push_back(z * side + x + 1);       // Top right
+
+            indices.push_back((z + 1) * side + x);     // Bottom left
+            indices.push_back((z + 1) * side + x + 1); // Bottom right
+            indices.push_back(z * side + x + 1);       // Top right
+        }
+    }
+    patchIndexCount = (GLsizei) indices.size();
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &patchVBO);
+    glGenBuffers(1, &patchEBO);
+    glGenBuffers(1, &instanceVBO);
+
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (void*) 0);
+    glEnableVertexAttribArray(1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patchEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+
+    // Step 2: Per-node instance attribute, refilled every frame by select
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Node), (void*) 0);
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(2);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CDLODQuadtree::setCenter(const glm::vec2& center) {
+    this->center = center;
+}
+
+const glm::vec2& CDLODQuadtree::getCenter() const {
+    return center;
+}
+
+float CDLODQuadtree::getCenterSnap() const {
+    return 2.0f * extent / (float) patchResolution;
+}
+
+void CDLODQuadtree::select(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, float minHeight, float maxHeight) {
+    this->cameraPosition = cameraPosition;
+    this->minHeight = minHeight;
+    this->maxHeight = maxHeight;
+
+    // Step 1: Frustum planes from the rows of the view-projection matrix (Gribb/Hartmann)
+    for (int i = 0; i < 3; ++i) {
+        glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        frustumPlanes[2 * i] = w + row;
+        frustumPlanes[2 * i + 1] = w - row;
+    }
+
+    // Step 2: Walk the quadtree from the root
+    selection.clear();
+    glm::vec2 corner = center - extent / 2.0f;
+    if (!selectNode(corner.x, corner.y, extent, levels - 1)) {
+        // The camera is beyond even the coarsest range: draw the root as is
+        selection.push_back({corner.x, corner.y, extent, (float) (levels - 1)});
+    }
+
+    // Step 3: Upload the selection, orphaning last frame's storage
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (selection.size() > instanceCapacity) {
+        instanceCapacity = selection.size() * 2;
+    }
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(Node), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, selection.size() * sizeof(Node), selection.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool CDLODQuadtree::selectNode(float x, float z, float size, int level) {
+    // Range tests use a box that also contains y = 0, the height shader.vert measures morph distances at, so a
+    // node outside a range has every vertex outside it too
+    glm::vec3 rangeMin(x, std::min(minHeight, 0.0f), z);
+    glm::vec3 rangeMax(x + size, std::max(maxHeight, 0.0f), z + size);
+
+    // Not within this level's range: the parent has to cover the area
+    if (!intersectsSphere(rangeMin, rangeMax, ranges[level])) {
+        return false;
+    }
+
+    // Handled, nothing visible
+    if (!inFrustum(glm::vec3(x, minHeight, z), glm::vec3(x + size, maxHeight, z + size))) {
+        return true;
+    }
+
+    if (level == 0 || !intersectsSphere(rangeMin, rangeMax, ranges[level - 1])) {
+        selection.push_back({x, z, size, (float) level});
+        return true;
+    }
+
+    // Children that fall outside the finer range are drawn at child size but tagged with the finer level: they lie
+    // past that level's morph end, so shader.vert fully morphs them down to this node's vertex density
+    float half = size / 2.0f;
+    for (int child = 0; child < 4; ++child) {
+        float childX = x + (child % 2) * half;
+        float childZ = z + (child / 2) * half;
+        if (!selectNode(childX, childZ, half, level - 1)) {
+            selection.push_back({childX, childZ, half, (float) (level - 1)});
+        }
+    }
+    return true;
+}
+
+bool CDLODQuadtree::inFrustum(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+    for (const glm::vec4& plane : frustumPlanes) {
+        // Corner furthest along the plane normal
+        glm::vec3 corner(plane.x >= 0.0f ? boxMax.x : boxMin.x,
+                         plane.y >= 0.0f ? boxMax.y : boxMin.y,
+                         plane.z >= 0.0f ? boxMax.z : boxMin.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CDLODQuadtree::intersectsSphere(const glm::vec3& boxMin, const glm::vec3& boxMax, float radius) const {
+    glm::vec3 closest = glm::clamp(cameraPosition, boxMin, boxMax);
+    glm::vec3 offset = closest - cameraPosition;
+    return glm::dot(offset, offset) <= radius * radius;
+}
+
+void CDLODQuadtree::draw() const {
+    if (selection.empty()) {
+        return;
+    }
+    glBindVertexArray(vao);
+    glDrawElementsInstanced(GL_TRIANGLES, patchIndexCount, GL_UNSIGNED_SHORT, 0, (GLsizei) selection.size());
+    glBindVertexArray(0);
+}
+
+void CDLODQuadtree::cleanup() {
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (patchVBO) glDeleteBuffers(1, &patchVBO);
+    if (patchEBO) glDeleteBuffers(1, &patchEBO);
+    if (instanceVBO) glDeleteBuffers(1, &instanceVBO);
+    vao = 0;
+    patchVBO = 0;
+    patchEBO = 0;
+    instanceVBO = 0;
+}
+
+const std::vector<glm::vec2>& CDLODQuadtree::getMorphRanges() const {
+    return morphRanges;
+}
+
+int CDLODQuadtree::getPatchResolution() const {
+    return patchResolution;
+}
+
+int CDLODQuadtree::getLevelCount() const {
+    return levels;
+}
+
+size_t CDLODQuadtree::getSelectedCount() const {
+    return selection.size();
+}
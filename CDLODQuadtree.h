@@ -0,0 +1,76 @@
+#ifndef CDLODQUADTREE_H
+#define CDLODQUADTREE_H
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Continuous distance-dependent LOD (CDLOD) for the water surface. A quadtree over a square region is walked on
+// the CPU every frame; every selected node is drawn as one instance of a shared patchResolution^2 grid patch, and
+// shader.vert morphs each patch towards its parent's resolution near the end of its LOD range so levels blend
+// without cracks. Mesh density follows distance to the camera, not the FFT grid size.
+class CDLODQuadtree {
+public:
+    // Per-instance data, matches aNode in shader.vert
+    struct Node {
+        float x;     // Minimum corner
+        float z;
+        float size;  // Side length
+        float level; // 0 = finest
+    };
+
+    static const int maxLevels = 8;
+
+    // extent: side of the region centred on getCenter(), levels: quadtree depth, patchResolution: quads per patch
+    // side (even), finestRange: view distance covered by level 0; each coarser level doubles it
+    CDLODQuadtree(float extent, int levels, int patchResolution, float finestRange);
+
+    // Creates the patch mesh and instance buffer; needs a current GL context
+    void setup();
+    // Moves the region, e.g. to follow the camera. Snap the centre to a multiple of getCenterSnap() so vertices stay
+    // put in world space while it moves.
+    void setCenter(const glm::vec2& center);
+    const glm::vec2& getCenter() const;
+    // Spacing of the coarsest grid any vertex lands on: the root's morph target, every other vertex of the root
+    // patch. Every finer level's vertex and morph grid divides it.
+    float getCenterSnap() const;
+    // Selects and frustum-culls the nodes to draw. minHeight/maxHeight bound the displaced surface.
+    void select(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, float minHeight, float maxHeight);
+    // One instanced draw of all selected nodes
+    void draw() const;
+    // Deletes the GL objects while the context is current; global instances are destroyed after it, so there is no
+    // destructor doing this
+    void cleanup();
+
+    // (morph start, morph end) distance per level, for shader.vert
+    const std::vector<glm::vec2>& getMorphRanges() const;
+    int getPatchResolution() const;
+    int getLevelCount() const;
+    size_t getSelectedCount() const;
+private:
+    float extent;
+    glm::vec2 center;
+    int levels;
+    int patchResolution;
+    std::vector<float> ranges;         // View distance of each level
+    std::vector<glm::vec2> morphRanges;
+
+    glm::vec4 frustumPlanes[6];
+    glm::vec3 cameraPosition;
+    float minHeight;
+    float maxHeight;
+    std::vector<Node> selection;
+
+    GLuint vao;
+    GLuint patchVBO;
+    GLuint patchEBO;
+    GLuint instanceVBO;
+    GLsizei patchIndexCount;
+    size_t instanceCapacity;
+
+    bool selectNode(float x, float z, float size, int level);
+    bool inFrustum(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+    bool intersectsSphere(const glm::vec3& boxMin, const glm::vec3& boxMax, float radius) const;
+};
+
+#endif // CDLODQUADTREE_H
@@ -0,0 +1,347 @@
+#include "CPUFFT.h"
+#include "WorkerPool.h"
+#include "CPUSIMD.h"
+#include "FFTCodelets.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+namespace {
+
+using namespace simd;
+
+const size_t B = CPUFFT::blockWidth;
+const size_t elementStride = 2 * B; // Floats per block element: B real parts, then B imaginary parts
+
+// First stage when log2(N) is odd (Ns = 1, so every twiddle is 1)
+void radix2Stage(const float* src, float* dst, size_t N) {
+    size_t half = N / 2;
+    for (size_t j = 0; j < half; ++j) {
+        const float* a = src + j * elementStride;
+        const float* b = src + (j + half) * elementStride;
+        float* sum = dst + 2 * j * elementStride;
+        float* diff = sum + elementStride;
+        for (size_t l = 0; l < elementStride; l += lanes) {
+            Vec va = load(a + l);
+            Vec vb = load(b + l);
+            store(sum + l, add(va, vb));
+            store(diff + l, sub(va, vb));
+        }
+    }
+}
+
+// Stockham radix-4 stage for any N: butterfly j reads src[j + r * N / 4], twiddles them by
+// exp(2 * pi * i * r * k / (4 * Ns)), and writes the inverse 4-point DFT to dst[(j - k) * 4 + k + r * Ns], k = j % Ns
+void radix4Stage(const float* src, float* dst, size_t N, size_t Ns, const std::complex<float>* twiddles) {
+    size_t quarter = N / 4;
+    for (size_t j = 0; j < quarter; ++j) {
+        size_t k = j & (Ns - 1);
+        size_t step = k * (N / (4 * Ns));
+        fftcodelets::radix4Butterfly<true>(src + j * elementStride, quarter * elementStride,
+                                           dst + (((j - k) << 2) + k) * elementStride, Ns * elementStride,
+                                           broadcast(twiddles[step].real()), broadcast(twiddles[step].imag()),
+                                           broadcast(twiddles[2 * step].real()), broadcast(twiddles[2 * step].imag()),
+                                           broadcast(twiddles[3 * step].real()), broadcast(twiddles[3 * step].imag()));
+    }
+}
+
+// The first radix-2 stage when only src[0 .. band) and src[N - band .. N) can be nonzero and 4 * band <= N: butterfly
+// j sees a alone (j < band) or b alone (j >= N / 2 - band) and writes (a, a) or (b, -b); the others write zeros
+// nobody reads, as the output is confined to [0, 2 * band) and [N - 2 * band, N)
+void prunedRadix2Stage(const float* src, float* dst, size_t N, size_t band) {
+    size_t half = N / 2;
+    for (size_t j = 0; j < band; ++j) {
+        const float* a = src + j * elementStride;
+        float* out = dst + 2 * j * elementStride;
+        std::copy(a, a + elementStride, out);
+        std::copy(a, a + elementStride, out + elementStride);
+    }
+    Vec zero = broadcast(0.0f);
+    for (size_t j = half - band; j < half; ++j) {
+        const float* b = src + (j + half) * elementStride;
+        float* out = dst + 2 * j * elementStride;
+        for (size_t l = 0; l < elementStride; l += lanes) {
+            Vec vb = load(b + l);
+            store(out + l, vb);
+            store(out + elementStride + l, sub(zero, vb));
+        }
+    }
+}
+
+// Radix-4 stage with the input confined to the band, 8 * band <= N and band a multiple of Ns. Butterfly j then sees
+// v0 alone (j < band), whose twiddle is 1, or v3 alone (j >= N / 4 - band), and the output is confined to the band
+// 4 * band, made of whole butterfly groups
+void prunedRadix4Stage(const float* src, float* dst, size_t N, size_t Ns, size_t band,
+                       const std::complex<float>* twiddles) {
+    size_t quarter = N / 4;
+    for (size_t j = 0; j < band; ++j) {
+        size_t k = j & (Ns - 1);
+        const float* s0 = src + j * elementStride;
+        float* d0 = dst + (((j - k) << 2) + k) * elementStride;
+        for (size_t m = 0; m < 4; ++m) {
+            std::copy(s0, s0 + elementStride, d0 + m * Ns * elementStride);
+        }
+    }
+
+    Vec zero = broadcast(0.0f);
+    for (size_t j = quarter - band; j < quarter; ++j) {
+        size_t k = j & (Ns - 1);
+        const std::complex<float>& w = twiddles[3 * k * (N / (4 * Ns))];
+        Vec wr = broadcast(w.real()), wi = broadcast(w.imag());
+        const float* s3 = src + (j + 3 * quarter) * elementStride;
+        float* d0 = dst + (((j - k) << 2) + k) * elementStride;
+        float* d1 = d0 + Ns * elementStride;
+        float* d2 = d1 + Ns * elementStride;
+        float* d3 = d2 + Ns * elementStride;
+        for (size_t l = 0; l < B; l += lanes) {
+            Vec ar = load(s3 + l), ai = load(s3 + B + l);
+            Vec vr = mulSub(ar, wr, mul(ai, wi)), vi = mulAdd(ar, wi, mul(ai, wr));
+
+            // out[m] = v * i^(3 * m): v, -i * v, -v, i * v
+            store(d0 + l, vr);
+            store(d0 + B + l, vi);
+            store(d1 + l, vi);
+            store(d1 + B + l, sub(zero, vr));
+            store(d2 + l, sub(zero, vr));
+            store(d2 + B + l, sub(zero, vi));
+            store(d3 + l, sub(zero, vi));
+            store(d3 + B + l, vr);
+        }
+    }
+}
+
+// Calls body(i) for the indices [0, band) and [N - band, N) of a line
+template <typename Body>
+void forEachBandIndex(size_t N, size_t band, Body body) {
+    for (size_t i = 0; i < band; ++i) {
+        body(i);
+    }
+    for (size_t i = N - band; i < N; ++i) {
+        body(i);
+    }
+}
+
+std::vector<std::complex<float>> makeTwiddles(size_t N) {
+    // In double precision, rounded once
+    std::vector<std::complex<float>> twiddles(N);
+    for (size_t t = 0; t < N; ++t) {
+        double angle = 2.0 * fftcodelets::pi * (double) t / (double) N;
+        twiddles[t] = std::complex<float>((float) std::cos(angle), (float) std::sin(angle));
+    }
+    return twiddles;
+}
+
+} // namespace
+
+CPUFFT::CPUFFT() : N(0), band(0), codelet(nullptr) {}
+
+CPUFFT::~CPUFFT() = default;
+
+bool CPUFFT::setup(size_t gridSize, size_t threads) {
+    if (gridSize < 2 || (gridSize & (gridSize - 1)) != 0) {
+        std::cerr << "CPU FFT needs a power of two grid size, got " << gridSize << std::endl;
+        return false;
+    }
+    N = gridSize;
+    band = N / 2;
+
+    // Step 1: Fixed-size codelet for the usual grid sizes, otherwise twiddles
+    codelet = fftcodelets::findBlockTransform(N);
+    twiddles = codelet ? std::vector<std::complex<float>>() : makeTwiddles(N);
+
+    if (N < B) {
+        // Step 2a: Too small to block: bit-reversal permutation of log2(N) bits for the line transform
+        int log2N = 0;
+        while ((size_t(1) << log2N) < N) {
+            ++log2N;
+        }
+        bitReverse.resize(N);
+        for (size_t i = 0; i < N; ++i) {
+            uint32_t reversed = 0;
+            for (int bit = 0; bit < log2N; ++bit) {
+                reversed |= ((i >> bit) & 1u) << (log2N - 1 - bit);
+            }
+            bitReverse[i] = reversed;
+        }
+        grid.resize(N * N);
+        line.resize(N);
+        workers.reset();
+        scratch.clear();
+        return true;
+    }
+
+    // Step 2b: Workers, never more than there are blocks, each with its own ping-pong block
+    size_t blocks = N / B;
+    size_t workerCount = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    workers.reset(new WorkerPool(std::min(workerCount, blocks)));
+    scratch.assign(workers->getWorkerCount(), std::vector<float>(2 * N * elementStride));
+    grid.resize(N * N);
+    return true;
+}
+
+size_t CPUFFT::getGridSize() const {
+    return N;
+}
+
+void CPUFFT::setBandLimit(size_t band) {
+    this->band = band && band < N / 2 ? band : N / 2;
+    // The pruned stages take their twiddles at run time, even where a codelet runs the rest
+    if (this->band < N / 2 && twiddles.empty()) {
+        twiddles = makeTwiddles(N);
+    }
+}
+
+float* CPUFFT::transformBlock(float* buffer) const {
+    float* src = buffer;
+    float* dst = buffer + N * elementStride;
+    bool radix2 = (N & 0xAAAAAAAAu) != 0; // N has its bit at an odd position, i.e. log2(N) is odd
+    size_t Ns = 1;
+    size_t width = band;
+
+    // Step 1: Stages whose input is still confined to the band; each widens it by its radix
+    if (radix2 && 4 * width <= N) {
+        prunedRadix2Stage(src, dst, N, width);
+        std::swap(src, dst);
+        width *= 2;
+        Ns = 2;
+    }
+    for (; 8 * width <= N; Ns *= 4) {
+        prunedRadix4Stage(src, dst, N, Ns, width, twiddles.data());
+        std::swap(src, dst);
+        width *= 4;
+    }
+
+    // Step 2: Nothing wrote the rest of the line yet
+    if (width < N / 2) {
+        std::fill(src + width * elementStride, src + (N - width) * elementStride, 0.0f);
+    }
+
+    // Step 3: Full stages: one radix-2 stage first if log2(N) is odd, then radix-4 from length 2
+    if (codelet) {
+        return codelet(src, dst, Ns);
+    }
+    if (radix2 && Ns == 1) {
+        radix2Stage(src, dst, N);
+        std::swap(src, dst);
+        Ns = 2;
+    }
+    for (; Ns < N; Ns *= 4) {
+        radix4Stage(src, dst, N, Ns, twiddles.data());
+        std::swap(src, dst);
+    }
+    return src;
+}
+
+void CPUFFT::inverse(const float* input, float* output) {
+    if (!N) {
+        return;
+    }
+    if (N < B) {
+        inverseSmall(input, output);
+        return;
+    }
+
+    const std::complex<float>* in = reinterpret_cast<const std::complex<float>*>(input);
+    std::complex<float>* out = reinterpret_cast<std::complex<float>*>(output);
+    size_t blocks = N / B;
+    // Blocks of columns that touch the band, half of them at either end
+    size_t bandBlocks = std::min(blocks, 2 * ((band + B - 1) / B));
+    size_t lowBlocks = (bandBlocks + 1) / 2;
+
+    // Step 1: Columns. B neighbouring columns are B contiguous complex values per row, copied into the lanes. Columns
+    // outside the band are zero, so their blocks are skipped, and only the band of each column is copied.
+    workers->parallelFor(bandBlocks, 1, [&](size_t begin, size_t end, size_t worker) {
+        float* buffer = scratch[worker].data();
+        for (size_t index = begin; index < end; ++index) {
+            size_t x0 = (index < lowBlocks ? index : blocks - bandBlocks + index) * B;
+            forEachBandIndex(N, band, [&](size_t y) {
+                float* element = buffer + y * elementStride;
+                const std::complex<float>* row = in + y * N + x0;
+                for (size_t l = 0; l < B; ++l) {
+                    element[l] = row[l].real();
+                    element[B + l] = row[l].imag();
+                }
+            });
+            const float* result = transformBlock(buffer);
+            for (size_t y = 0; y < N; ++y) {
+                const float* element = result + y * elementStride;
+                std::complex<float>* row = &grid[y * N + x0];
+                for (size_t l = 0; l < B; ++l) {
+                    row[l] = std::complex<float>(element[l], element[B + l]);
+                }
+            }
+        }
+    });
+
+    // Step 2: Rows. Copying B rows into the lanes transposes them within the cache-resident block; only the band
+    // columns are read, the others were never written. Scale on the way out.
+    float scale = 1.0f / (float) (N * N);
+    workers->parallelFor(blocks, 1, [&](size_t begin, size_t end, size_t worker) {
+        float* buffer = scratch[worker].data();
+        for (size_t block = begin; block < end; ++block) {
+            size_t y0 = block * B;
+            for (size_t l = 0; l < B; ++l) {
+                const std::complex<float>* row = &grid[(y0 + l) * N];
+                forEachBandIndex(N, band, [&](size_t x) {
+                    buffer[x * elementStride + l] = row[x].real();
+                    buffer[x * elementStride + B + l] = row[x].imag();
+                });
+            }
+            const float* result = transformBlock(buffer);
+            for (size_t l = 0; l < B; ++l) {
+                std::complex<float>* row = out + (y0 + l) * N;
+                for (size_t x = 0; x < N; ++x) {
+                    row[x] = std::complex<float>(result[x * elementStride + l], result[x * elementStride + B + l]) * scale;
+                }
+            }
+        }
+    });
+}
+
+void CPUFFT::transformLine(std::complex<float>* data) const {
+    for (size_t i = 0; i < N; ++i) {
+        if (i < bitReverse[i]) {
+            std::swap(data[i], data[bitReverse[i]]);
+        }
+    }
+
+    // Decimation in time; the inverse transform uses the positive twiddle angles
+    for (size_t half = 1; half < N; half *= 2) {
+        size_t twiddleStep = N / (2 * half);
+        for (size_t start = 0; start < N; start += 2 * half) {
+            for (size_t k = 0; k < half; ++k) {
+                std::complex<float> a = data[start + k];
+                std::complex<float> b = data[start + k + half] * twiddles[k * twiddleStep];
+                data[start + k] = a + b;
+                data[start + k + half] = a - b;
+            }
+        }
+    }
+}
+
+void CPUFFT::inverseSmall(const float* input, float* output) {
+    // Step 1: Rows, in place in the working copy. Only the band is copied in, the bins outside it are zero like on
+    // the blocked path, and rows outside the band stay zero once transformed.
+    const std::complex<float>* in = reinterpret_cast<const std::complex<float>*>(input);
+    grid.assign(N * N, std::complex<float>(0.0f, 0.0f));
+    forEachBandIndex(N, band, [&](size_t y) {
+        forEachBandIndex(N, band, [&](size_t x) {
+            grid[y * N + x] = in[y * N + x];
+        });
+        transformLine(&grid[y * N]);
+    });
+
+    // Step 2: Columns through the line buffer, scaled on the way out
+    std::complex<float>* out = reinterpret_cast<std::complex<float>*>(output);
+    float scale = 1.0f / (float) (N * N);
+    for (size_t x = 0; x < N; ++x) {
+        for (size_t y = 0; y < N; ++y) {
+            line[y] = grid[y * N + x];
+        }
+        transformLine(line.data());
+        for (size_t y = 0; y < N; ++y) {
+            out[y * N + x] = line[y] * scale;
+        }
+    }
+}
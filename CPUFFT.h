@@ -0,0 +1,57 @@
+#ifndef CPUFFT_H
+#define CPUFFT_H
+
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class WorkerPool;
+
+// Portable inverse 2D FFT on the host for power-of-two N x N grids. Both passes transform blockWidth lines at a
+// time: a block is copied into per-worker scratch in split (re, im) form with one SIMD lane per line (for rows this
+// copy is the transpose, done in cache), run through radix-4 Stockham stages with AVX-512, AVX, SSE or NEON
+// vectors across the lanes, and copied back. Blocks are spread over a WorkerPool. Grid sizes 256 to 4096 use
+// compile-time specialized codelets; others get twiddles at setup. Scratch is set up once per plan, so transforms
+// allocate nothing.
+class CPUFFT {
+public:
+    // Lines per block: one 64-byte cache line of real parts per element
+    static const size_t blockWidth = 16;
+
+    CPUFFT();
+    ~CPUFFT();
+
+    // false (with the reason on std::cerr) unless gridSize is a power of two. threads = 0 uses every hardware
+    // thread.
+    bool setup(size_t gridSize, size_t threads = 0);
+    size_t getGridSize() const;
+    // Input bins whose index on either axis is band or more away from 0 (mod N) are treated as zero and skipped: the
+    // column pass only transforms blocks that touch the band, and every line skips the work of the stages whose
+    // input is still confined to it. 0 or >= N / 2 transforms everything. Call after setup.
+    void setBandLimit(size_t band);
+
+    // input and output hold 2 * N * N interleaved (re, im) floats and may be the same array. The result is scaled
+    // by 1 / N^2, like clFFT's backward transform.
+    void inverse(const float* input, float* output);
+private:
+    size_t N;
+    size_t band;                               // Nonzero input indices are [0, band) and [N - band, N)
+    float* (*codelet)(float* src, float* dst, size_t firstNs); // Fixed-size block transform (FFTCodelets.h), if any
+    std::vector<std::complex<float>> twiddles; // exp(2 * pi * i * t / N), t < N; with a codelet only for pruned stages
+    std::vector<std::complex<float>> grid;     // Result of the column pass
+    std::vector<std::vector<float>> scratch;   // Per worker: two blocks of N elements x (blockWidth re + im)
+    std::unique_ptr<WorkerPool> workers;
+
+    // Grids smaller than a block: one line at a time, radix-2 with bit reversal
+    std::vector<uint32_t> bitReverse;
+    std::vector<std::complex<float>> line;
+
+    // Transforms the block in buffer[0], of which only the band was filled, and returns the half of scratch
+    // holding the result
+    float* transformBlock(float* buffer) const;
+    void transformLine(std::complex<float>* data) const;
+    void inverseSmall(const float* input, float* output);
+};
+
+#endif // CPUFFT_H
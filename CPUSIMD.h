@@ -0,0 +1,79 @@
+#ifndef CPUSIMD_H
+#define CPUSIMD_H
+
+#include <cstddef>
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// The few vector operations the CPU FFT butterflies need, on the widest instruction set the compiler targets. Lanes
+// are independent lines of a block, so no shuffles are needed.
+namespace simd {
+
+#if defined(__AVX512F__)
+typedef __m512 Vec;
+const size_t lanes = 16;
+inline Vec load(const float* p) { return _mm512_loadu_ps(p); }
+inline void store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+inline Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+inline Vec broadcast(float x) { return _mm512_set1_ps(x); }
+inline Vec mulAdd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+inline Vec mulSub(Vec a, Vec b, Vec c) { return _mm512_fmsub_ps(a, b, c); }
+#elif defined(__AVX__)
+typedef __m256 Vec;
+const size_t lanes = 8;
+inline Vec load(const float* p) { return _mm256_loadu_ps(p); }
+inline void store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+inline Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+inline Vec broadcast(float x) { return _mm256_set1_ps(x); }
+#ifdef __FMA__
+inline Vec mulAdd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+inline Vec mulSub(Vec a, Vec b, Vec c) { return _mm256_fmsub_ps(a, b, c); }
+#else
+inline Vec mulAdd(Vec a, Vec b, Vec c) { return add(mul(a, b), c); }
+inline Vec mulSub(Vec a, Vec b, Vec c) { return sub(mul(a, b), c); }
+#endif
+#elif defined(__SSE2__) || defined(_M_X64)
+typedef __m128 Vec;
+const size_t lanes = 4;
+inline Vec load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+inline Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+inline Vec broadcast(float x) { return _mm_set1_ps(x); }
+inline Vec mulAdd(Vec a, Vec b, Vec c) { return add(mul(a, b), c); }
+inline Vec mulSub(Vec a, Vec b, Vec c) { return sub(mul(a, b), c); }
+#elif defined(__ARM_NEON)
+typedef float32x4_t Vec;
+const size_t lanes = 4;
+inline Vec load(const float* p) { return vld1q_f32(p); }
+inline void store(float* p, Vec v) { vst1q_f32(p, v); }
+inline Vec add(Vec a, Vec b) { return vaddq_f32(a, b); }
+inline Vec sub(Vec a, Vec b) { return vsubq_f32(a, b); }
+inline Vec mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+inline Vec broadcast(float x) { return vdupq_n_f32(x); }
+inline Vec mulAdd(Vec a, Vec b, Vec c) { return vmlaq_f32(c, a, b); }
+inline Vec mulSub(Vec a, Vec b, Vec c) { return vsubq_f32(vmulq_f32(a, b), c); }
+#else
+typedef float Vec;
+const size_t lanes = 1;
+inline Vec load(const float* p) { return *p; }
+inline void store(float* p, Vec v) { *p = v; }
+inline Vec add(Vec a, Vec b) { return a + b; }
+inline Vec sub(Vec a, Vec b) { return a - b; }
+inline Vec mul(Vec a, Vec b) { return a * b; }
+inline Vec broadcast(float x) { return x; }
+inline Vec mulAdd(Vec a, Vec b, Vec c) { return a * b + c; }
+inline Vec mulSub(Vec a, Vec b, Vec c) { return a * b - c; }
+#endif
+
+} // namespace simd
+
+#endif // CPUSIMD_H
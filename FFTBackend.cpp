@@ -0,0 +1,251 @@
+#include "FFTBackend.h"
+#include "OpenCLFFT.h"
+#include "CPUFFT.h"
+#ifdef __APPLE__
+#include "IFFT.h"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+namespace {
+
+// OpenCLFFT exits on CL errors, so only offer its backends where there is a platform to run on
+bool openCLAvailable() {
+    cl_uint platforms = 0;
+    return clGetPlatformIDs(0, nullptr, &platforms) == CL_SUCCESS && platforms > 0;
+}
+
+// Host path of OpenCLFFT: write, transform, read back
+class OpenCLFFTBackend : public FFTBackend {
+public:
+    OpenCLFFTBackend(const char* name, OpenCLFFT::Engine engine) : name(name), engine(engine), gridSize(0), batch(0) {}
+
+    const char* getName() const override {
+        return name;
+    }
+
+    Capabilities getCapabilities() const override {
+        return {true, true, 1};
+    }
+
+    bool plan(size_t gridSize, size_t batch) override {
+        processor.setEngine(engine);
+        processor.setup(gridSize);
+        if (processor.getEngine() != engine) {
+            return false; // OpenCLFFT fell back to the other engine
+        }
+        this->gridSize = gridSize;
+        this->batch = batch;
+        return true;
+    }
+
+    void executeInverse(const GLfloat* input, GLfloat* output) override {
+        size_t gridFloats = 2 * gridSize * gridSize;
+        for (size_t b = 0; b < batch; ++b) {
+            processor.performIFFTFromOpenGLTexture(input + b * gridFloats, output + b * gridFloats, gridFloats);
+        }
+    }
+
+    bool configureInterop(OpenCLFFT& processor) const override {
+        processor.setEngine(engine);
+        return true;
+    }
+
+    void setBandLimit(size_t band) override {
+        processor.setBandLimit(band);
+    }
+private:
+    const char* name;
+    OpenCLFFT::Engine engine;
+    OpenCLFFT processor;
+    size_t gridSize;
+    size_t batch;
+};
+
+class CPUFFTBackend : public FFTBackend {
+public:
+    CPUFFTBackend() : batch(0) {}
+
+    const char* getName() const override {
+        return "cpu";
+    }
+
+    Capabilities getCapabilities() const override {
+        return {false, false, 1};
+    }
+
+    bool plan(size_t gridSize, size_t batch) override {
+        this->batch = batch;
+        return fft.setup(gridSize);
+    }
+
+    void executeInverse(const GLfloat* input, GLfloat* output) override {
+        size_t gridFloats = 2 * fft.getGridSize() * fft.getGridSize();
+        for (size_t b = 0; b < batch; ++b) {
+            fft.inverse(input + b * gridFloats, output + b * gridFloats);
+        }
+    }
+
+    void setBandLimit(size_t band) override {
+        fft.setBandLimit(band);
+    }
+private:
+    CPUFFT fft;
+    size_t batch;
+};
+
+#ifdef __APPLE__
+class VDSPBackend : public FFTBackend {
+public:
+    VDSPBackend() : gridSize(0), batch(0) {}
+
+    const char* getName() const override {
+        return "vdsp";
+    }
+
+    Capabilities getCapabilities() const override {
+        return {false, false, 1};
+    }
+
+    bool plan(size_t gridSize, size_t batch) override {
+        if (gridSize < 2 || (gridSize & (gridSize - 1)) != 0) {
+            std::cerr << "vDSP FFT needs a power of two grid size, got " << gridSize << std::endl;
+            return false;
+        }
+        this->gridSize = gridSize;
+        this->batch = batch;
+        return true;
+    }
+
+    void executeInverse(const GLfloat* input, GLfloat* output) override {
+        size_t gridFloats = 2 * gridSize * gridSize;
+        for (size_t b = 0; b < batch; ++b) {
+            ifft.performIFFT(input + b * gridFloats, output + b * gridFloats, gridSize);
+        }
+    }
+private:
+    IFFT ifft;
+    size_t gridSize;
+    size_t batch;
+};
+#endif
+
+} // namespace
+
+bool FFTBackend::configureInterop(OpenCLFFT&) const {
+    return false;
+}
+
+void FFTBackend::setBandLimit(size_t) {}
+
+size_t FFTBackend::spectrumBand(const GLfloat* spectrum, size_t gridSize, double energyThreshold) {
+    // Step 1: Energy per ring of the square band, i.e. by the larger of the two distances from index 0
+    size_t half = gridSize / 2;
+    std::vector<double> ringEnergy(half + 1, 0.0);
+    double total = 0.0;
+    for (size_t y = 0; y < gridSize; ++y) {
+        size_t ringY = std::min(y, gridSize - y);
+        for (size_t x = 0; x < gridSize; ++x) {
+            const GLfloat* bin = spectrum + 2 * (y * gridSize + x);
+            double energy = (double) bin[0] * bin[0] + (double) bin[1] * bin[1];
+            ringEnergy[std::max(ringY, std::min(x, gridSize - x))] += energy;
+            total += energy;
+        }
+    }
+
+    // Step 2: Drop outer rings while what they hold stays under the threshold. The band keeps index N - band, so ring
+    // band is only half dropped; counting all of it errs on the safe side. Ring N / 2 goes with the first ring.
+    double dropped = ringEnergy[half];
+    size_t band = half;
+    while (band > 1 && dropped + ringEnergy[band - 1] <= energyThreshold * total) {
+        dropped += ringEnergy[--band];
+    }
+    return band;
+}
+
+std::vector<std::string> FFTBackend::availableNames() {
+    std::vector<std::string> names;
+    if (openCLAvailable()) {
+        names.push_back("clfft");
+        names.push_back("stockham-cl");
+    }
+#ifdef __APPLE__
+    names.push_back("vdsp");
+#endif
+    names.push_back("cpu");
+    return names;
+}
+
+std::unique_ptr<FFTBackend> FFTBackend::create(const std::string& name) {
+    bool openCL = (name == "clfft" || name == "stockham-cl") && openCLAvailable();
+    if (openCL && name == "clfft") {
+        return std::unique_ptr<FFTBackend>(new OpenCLFFTBackend("clfft", OpenCLFFT::Engine::ClFFT));
+    }
+    if (openCL) {
+        return std::unique_ptr<FFTBackend>(new OpenCLFFTBackend("stockham-cl", OpenCLFFT::Engine::Stockham));
+    }
+#ifdef __APPLE__
+    if (name == "vdsp") {
+        return std::unique_ptr<FFTBackend>(new VDSPBackend());
+    }
+#endif
+    if (name == "cpu") {
+        return std::unique_ptr<FFTBackend>(new CPUFFTBackend());
+    }
+    return nullptr;
+}
+
+double FFTBackend::benchmark(FFTBackend& backend, size_t gridSize, int iterations) {
+    // A spectrum of the same scale as computeFourier.frag's, so no backend hits denormals the real one would not
+    std::vector<GLfloat> spectrum(2 * gridSize * gridSize);
+    std::vector<GLfloat> result(spectrum.size());
+    std::mt19937 random(1);
+    std::normal_distribution<float> gaussian(0.0f, 1e-3f);
+    for (GLfloat& value : spectrum) {
+        value = gaussian(random);
+    }
+
+    backend.executeInverse(spectrum.data(), result.data()); // Warm-up: lazy allocations, kernel compiles, caches
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        backend.executeInverse(spectrum.data(), result.data());
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / std::max(iterations, 1);
+}
+
+std::unique_ptr<FFTBackend> FFTBackend::select(const std::string& name, size_t gridSize) {
+    if (name != "auto") {
+        std::unique_ptr<FFTBackend> backend = create(name);
+        if (backend && backend->plan(gridSize)) {
+            return backend;
+        }
+        std::cerr << "FFT backend \"" << name << "\" is not available, benchmarking the others" << std::endl;
+    }
+
+    // Every available backend transforms the same spectrum; keep the fastest
+    const int iterations = 5;
+    std::unique_ptr<FFTBackend> fastest;
+    double fastestTime = 0.0;
+    std::cout << "FFT backends (" << gridSize << "x" << gridSize << " inverse, host memory):" << std::endl;
+    for (const std::string& candidateName : availableNames()) {
+        std::unique_ptr<FFTBackend> candidate = create(candidateName);
+        if (!candidate || !candidate->plan(gridSize)) {
+            continue;
+        }
+        double time = benchmark(*candidate, gridSize, iterations);
+        std::cout << "  " << std::left << std::setw(12) << candidateName << std::fixed << std::setprecision(2)
+                  << time << " ms" << std::endl;
+        if (!fastest || time < fastestTime) {
+            fastest = std::move(candidate);
+            fastestTime = time;
+        }
+    }
+    if (fastest) {
+        std::cout << "Using FFT backend " << fastest->getName() << std::endl;
+    }
+    return fastest;
+}
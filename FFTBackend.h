@@ -0,0 +1,54 @@
+#ifndef FFTBACKEND_H
+#define FFTBACKEND_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+class OpenCLFFT;
+
+// One implementation of the ocean's inverse 2D FFT on host memory, so ifft() can switch engines at runtime.
+// Grids are N x N interleaved (re, im) floats, and results are scaled by 1 / N^2 like clFFT's backward transform.
+// Built-in backends: "clfft" and "stockham-cl" (OpenCLFFT with either engine), "cpu" (CPUFFT) and, on macOS,
+// "vdsp" (IFFT's Accelerate build).
+class FFTBackend {
+public:
+    struct Capabilities {
+        bool gpu;        // Runs on an OpenCL device rather than the host CPU
+        bool glInterop;  // Can also drive OpenCLFFT's GL interop path, see configureInterop
+        size_t maxBatch; // Grids transformed by one native launch; executeInverse loops over larger batches
+    };
+
+    virtual ~FFTBackend() = default;
+
+    virtual const char* getName() const = 0;
+    virtual Capabilities getCapabilities() const = 0;
+    // Prepares transforms of batch grids of gridSize x gridSize; false (with the reason on std::cerr) if this
+    // backend cannot run them
+    virtual bool plan(size_t gridSize, size_t batch = 1) = 0;
+    // input and output hold batch * 2 * N * N floats
+    virtual void executeInverse(const GLfloat* input, GLfloat* output) = 0;
+    // Configures processor (before its setup) to run the same transform on the GL interop path; false for
+    // host-only backends
+    virtual bool configureInterop(OpenCLFFT& processor) const;
+    // Lets the backend treat input bins whose index on either axis is band or more away from 0 (mod N) as zero and
+    // skip them (see spectrumBand). 0 transforms everything, and so do backends that cannot prune. Call after plan.
+    virtual void setBandLimit(size_t band);
+
+    // Backends built into this binary and usable on this machine
+    static std::vector<std::string> availableNames();
+    // nullptr for unknown or unavailable names
+    static std::unique_ptr<FFTBackend> create(const std::string& name);
+    // Average milliseconds per executeInverse of a backend planned for one gridSize grid, on a random spectrum and
+    // after one warm-up run
+    static double benchmark(FFTBackend& backend, size_t gridSize, int iterations);
+    // "auto" plans and benchmarks every available backend and keeps the fastest; any other name plans that backend
+    // and falls back to "auto" if it cannot. nullptr if nothing can transform gridSize.
+    static std::unique_ptr<FFTBackend> select(const std::string& name, size_t gridSize);
+    // Narrowest band for setBandLimit that leaves out at most energyThreshold of the energy of spectrum (one
+    // 2 * N * N float grid in FFT order); gridSize / 2 if the spectrum is not band-limited
+    static size_t spectrumBand(const GLfloat* spectrum, size_t gridSize, double energyThreshold);
+};
+
+#endif // FFTBACKEND_H
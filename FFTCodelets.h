@@ -0,0 +1,219 @@
+#ifndef FFTCODELETS_H
+#define FFTCODELETS_H
+
+#include <cstddef>
+#include "CPUFFT.h"
+#include "CPUSIMD.h"
+
+// Fixed-size inverse transforms of one CPUFFT block for the ocean grid sizes (powers of two from 256 to 4096).
+// Everything that depends on N is a template parameter: the radix schedule is unrolled into one call per stage,
+// loop bounds and strides are constants, the twiddle table is built by the compiler, and stages or butterflies whose
+// twiddles are all 1 skip the multiplies. findBlockTransform picks the instance for a runtime size, so these sizes
+// need no plan at all.
+namespace fftcodelets {
+
+using namespace simd;
+
+const size_t blockWidth = CPUFFT::blockWidth;
+const size_t elementStride = 2 * blockWidth; // Floats per block element: real parts, then imaginary parts
+
+constexpr double pi = 3.14159265358979323846;
+
+// Taylor series, accurate to double precision on [0, pi / 4]
+constexpr double sinTaylor(double x) {
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 12; ++n) {
+        term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double cosTaylor(double x) {
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 12; ++n) {
+        term *= -x * x / ((2.0 * n - 1.0) * (2.0 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+// exp(2 * pi * i * t / N), t < N. The angle is reduced to [0, pi / 4] with integer arithmetic, so the table is as
+// exact as one computed with std::cos and std::sin in double.
+template <size_t N>
+struct TwiddleTable {
+    float re[N];
+    float im[N];
+
+    constexpr TwiddleTable() : re(), im() {
+        for (size_t t = 0; t < N; ++t) {
+            size_t quadrant = 4 * t / N;
+            size_t r = t - quadrant * (N / 4);
+            bool mirrored = 8 * r > N; // Past pi / 4: use the complementary angle
+            double x = 2.0 * pi * (double) (mirrored ? N / 4 - r : r) / (double) N;
+            double c = mirrored ? sinTaylor(x) : cosTaylor(x);
+            double s = mirrored ? cosTaylor(x) : sinTaylor(x);
+            double rotatedC = quadrant == 0 ? c : quadrant == 1 ? -s : quadrant == 2 ? -c : s;
+            double rotatedS = quadrant == 0 ? s : quadrant == 1 ? c : quadrant == 2 ? -s : -c;
+            re[t] = (float) rotatedC;
+            im[t] = (float) rotatedS;
+        }
+    }
+};
+
+template <size_t N>
+struct Twiddles {
+    static constexpr TwiddleTable<N> table = TwiddleTable<N>();
+};
+
+// One radix-4 butterfly across the lanes of a block: v[r] = s0[r * sourceStride] * w[r] (w[0] = 1), written as the
+// inverse 4-point DFT out[m] = sum of v[r] * i^(r * m) to d0[m * targetStride]. Twiddled = false skips the
+// multiplies when every w[r] is 1.
+template <bool Twiddled>
+inline void radix4Butterfly(const float* s0, size_t sourceStride, float* d0, size_t targetStride,
+                            Vec w1r, Vec w1i, Vec w2r, Vec w2i, Vec w3r, Vec w3i) {
+    const float* s1 = s0 + sourceStride;
+    const float* s2 = s1 + sourceStride;
+    const float* s3 = s2 + sourceStride;
+    float* d1 = d0 + targetStride;
+    float* d2 = d1 + targetStride;
+    float* d3 = d2 + targetStride;
+
+    for (size_t l = 0; l < blockWidth; l += lanes) {
+        Vec v0r = load(s0 + l), v0i = load(s0 + blockWidth + l);
+        Vec v1r = load(s1 + l), v1i = load(s1 + blockWidth + l);
+        Vec v2r = load(s2 + l), v2i = load(s2 + blockWidth + l);
+        Vec v3r = load(s3 + l), v3i = load(s3 + blockWidth + l);
+
+        if (Twiddled) {
+            // (a.re + i a.im) * (w.re + i w.im)
+            Vec a1r = v1r, a2r = v2r, a3r = v3r;
+            v1r = mulSub(a1r, w1r, mul(v1i, w1i)), v1i = mulAdd(a1r, w1i, mul(v1i, w1r));
+            v2r = mulSub(a2r, w2r, mul(v2i, w2i)), v2i = mulAdd(a2r, w2i, mul(v2i, w2r));
+            v3r = mulSub(a3r, w3r, mul(v3i, w3i)), v3i = mulAdd(a3r, w3i, mul(v3i, w3r));
+        }
+
+        Vec sum02r = add(v0r, v2r), sum02i = add(v0i, v2i);
+        Vec diff02r = sub(v0r, v2r), diff02i = sub(v0i, v2i);
+        Vec sum13r = add(v1r, v3r), sum13i = add(v1i, v3i);
+        Vec diff13r = sub(v3i, v1i), diff13i = sub(v1r, v3r); // i * (v1 - v3)
+
+        store(d0 + l, add(sum02r, sum13r));
+        store(d0 + blockWidth + l, add(sum02i, sum13i));
+        store(d1 + l, add(diff02r, diff13r));
+        store(d1 + blockWidth + l, add(diff02i, diff13i));
+        store(d2 + l, sub(sum02r, sum13r));
+        store(d2 + blockWidth + l, sub(sum02i, sum13i));
+        store(d3 + l, sub(diff02r, diff13r));
+        store(d3 + blockWidth + l, sub(diff02i, diff13i));
+    }
+}
+
+// First stage when log2(N) is odd: radix-2 with Ns = 1, so every twiddle is 1
+template <size_t N>
+inline void radix2Stage(const float* src, float* dst) {
+    constexpr size_t half = N / 2;
+    for (size_t j = 0; j < half; ++j) {
+        const float* a = src + j * elementStride;
+        const float* b = src + (j + half) * elementStride;
+        float* sum = dst + 2 * j * elementStride;
+        float* diff = sum + elementStride;
+        for (size_t l = 0; l < elementStride; l += lanes) {
+            Vec va = load(a + l);
+            Vec vb = load(b + l);
+            store(sum + l, add(va, vb));
+            store(diff + l, sub(va, vb));
+        }
+    }
+}
+
+// Stockham radix-4 stage after sub-transforms of length Ns. Butterfly j = group * Ns + k reads src[j + r * N / 4]
+// and writes dst[group * 4 * Ns + k + m * Ns]; iterating k outermost loads each twiddle once per stage.
+template <size_t N, size_t Ns>
+inline void radix4Stage(const float* src, float* dst) {
+    constexpr size_t groups = N / (4 * Ns);
+    constexpr size_t sourceStride = N / 4 * elementStride;
+    constexpr size_t targetStride = Ns * elementStride;
+    const TwiddleTable<N>& w = Twiddles<N>::table;
+
+    for (size_t k = 0; k < Ns; ++k) {
+        const float* s0 = src + k * elementStride;
+        float* d0 = dst + k * elementStride;
+        if (k == 0) {
+            Vec one = broadcast(1.0f), zero = broadcast(0.0f);
+            for (size_t group = 0; group < groups; ++group) {
+                radix4Butterfly<false>(s0 + group * Ns * elementStride, sourceStride,
+                                       d0 + group * 4 * targetStride, targetStride, one, zero, one, zero, one, zero);
+            }
+            continue;
+        }
+
+        size_t step = k * groups; // k * N / (4 * Ns)
+        Vec w1r = broadcast(w.re[step]), w1i = broadcast(w.im[step]);
+        Vec w2r = broadcast(w.re[2 * step]), w2i = broadcast(w.im[2 * step]);
+        Vec w3r = broadcast(w.re[3 * step]), w3i = broadcast(w.im[3 * step]);
+        for (size_t group = 0; group < groups; ++group) {
+            radix4Butterfly<true>(s0 + group * Ns * elementStride, sourceStride,
+                                  d0 + group * 4 * targetStride, targetStride, w1r, w1i, w2r, w2i, w3r, w3i);
+        }
+    }
+}
+
+// The radix-4 stages from Ns up to N, one instantiation each, skipping those for sub-transforms shorter than
+// firstNs; returns the buffer holding the result
+template <size_t N, size_t Ns, bool Done = (Ns >= N)>
+struct Radix4Stages {
+    static float* run(float* src, float* dst, size_t firstNs) {
+        if (Ns < firstNs) {
+            return Radix4Stages<N, Ns * 4>::run(src, dst, firstNs);
+        }
+        radix4Stage<N, Ns>(src, dst);
+        return Radix4Stages<N, Ns * 4>::run(dst, src, firstNs);
+    }
+};
+
+template <size_t N, size_t Ns>
+struct Radix4Stages<N, Ns, true> {
+    static float* run(float* src, float*, size_t) {
+        return src;
+    }
+};
+
+constexpr bool oddLog2(size_t n) {
+    return n > 1 && !oddLog2(n / 2);
+}
+
+// Inverse transform of the block in src (ping-ponging with dst, both N elements), without scaling. firstNs > 1
+// resumes after the stages for shorter sub-transforms have already run (see CPUFFT's pruned stages).
+template <size_t N>
+float* inverseBlock(float* src, float* dst, size_t firstNs) {
+    static_assert(N >= 8 && (N & (N - 1)) == 0, "FFT codelets need a power of two of at least 8");
+    if (oddLog2(N)) {
+        if (firstNs == 1) {
+            radix2Stage<N>(src, dst);
+            return Radix4Stages<N, 2>::run(dst, src, 2);
+        }
+        return Radix4Stages<N, 2>::run(src, dst, firstNs);
+    }
+    return Radix4Stages<N, 1>::run(src, dst, firstNs);
+}
+
+typedef float* (*BlockTransform)(float* src, float* dst, size_t firstNs);
+
+// The codelet for N, or nullptr for sizes without one
+inline BlockTransform findBlockTransform(size_t N) {
+    switch (N) {
+        case 256: return &inverseBlock<256>;
+        case 512: return &inverseBlock<512>;
+        case 1024: return &inverseBlock<1024>;
+        case 2048: return &inverseBlock<2048>;
+        case 4096: return &inverseBlock<4096>;
+        default: return nullptr;
+    }
+}
+
+} // namespace fftcodelets
+
+#endif // FFTCODELETS_H
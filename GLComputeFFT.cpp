@@ -0,0 +1,90 @@
+#include "GLComputeFFT.h"
+#include <iostream>
+#include <string>
+#include <algorithm>
+
+GLComputeFFT::GLComputeFFT() : N(0), patchSize(1.0f), heightScale(1000.0f), heightOffset(10.0f) {}
+
+bool GLComputeFFT::isSupported() {
+    return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_image_load_store);
+}
+
+void GLComputeFFT::setHeightScale(float scale, float offset) {
+    heightScale = scale;
+    heightOffset = offset;
+}
+
+bool GLComputeFFT::setup(size_t gridSize, float patchSize, float repeatTime) {
+    cleanup();
+    this->patchSize = patchSize;
+
+    // Step 1: Check N against the shared memory and work-group limits
+    int log2N = 0;
+    while ((size_t(1) << log2N) < gridSize) {
+        ++log2N;
+    }
+    if (gridSize < 2 || (size_t(1) << log2N) != gridSize) {
+        std::cerr << "GL compute FFT needs a power of two grid size, got " << gridSize << std::endl;
+        return false;
+    }
+    GLint sharedMemory = 0;
+    GLint maxInvocations = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_SHARED_MEMORY_SIZE, &sharedMemory);
+    glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+    if (GLint(2 * gridSize * 2 * sizeof(float)) > sharedMemory) {
+        std::cerr << "GL compute FFT: " << gridSize << " points do not fit in " << sharedMemory
+                  << " bytes of shared memory" << std::endl;
+        return false;
+    }
+    // One invocation per butterfly, up to 256 (each loops over the rest)
+    size_t workgroupSize = std::min<size_t>(std::min<size_t>(gridSize / 2, 256), size_t(std::max(maxInvocations, 1)));
+
+    // Step 2: Compile the row and column variants
+    std::string defines = "#define FFT_N " + std::to_string(gridSize) + "\n" +
+                          "#define WORKGROUP_SIZE " + std::to_string(workgroupSize) + "\n" +
+                          "#define OCEAN_REPEAT_TIME " + std::to_string(repeatTime) + "\n";
+    rowProgram.begin({{GL_COMPUTE_SHADER, "../fftStockham.comp", defines + "#define FFT_ROWS"}});
+    columnProgram.begin({{GL_COMPUTE_SHADER, "../fftStockham.comp", defines + "#define FFT_COLUMNS"}});
+    if (!rowProgram.finish() || !columnProgram.finish()) {
+        cleanup();
+        return false;
+    }
+    N = gridSize;
+    return true;
+}
+
+void GLComputeFFT::setPatchSize(float patchSize) {
+    this->patchSize = patchSize;
+}
+
+void GLComputeFFT::dispatch(GLuint h0Texture, GLuint intermediateTexture, GLuint heightTexture, float time) {
+    if (!N) {
+        return;
+    }
+
+    // Step 1: Evolve the spectrum and transform the rows
+    rowProgram.use();
+    rowProgram.set("time", time);
+    rowProgram.set("patchSize", patchSize);
+    glBindImageTexture(0, h0Texture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(1, intermediateTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+    glDispatchCompute(GLuint(N), 1, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // Step 2: Transform the columns and rescale into the height texture
+    columnProgram.use();
+    columnProgram.set("heightScale", heightScale);
+    columnProgram.set("heightOffset", heightOffset);
+    glBindImageTexture(0, intermediateTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(1, heightTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+    glDispatchCompute(GLuint(N), 1, 1);
+
+    // Step 3: Make the height visible to the water shader's texture fetches
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void GLComputeFFT::cleanup() {
+    rowProgram.destroy();
+    columnProgram.destroy();
+    N = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef GLCOMPUTEFFT_H
+#define GLCOMPUTEFFT_H
+
+#include <GL/glew.h>
+#include "ShaderProgram.h"
+
+// Inverse 2D FFT of the ocean spectrum in GL 4.3 compute shaders (fftStockham.comp), so the whole frame stays on
+// one API with no CL/GL synchronisation or host copies. Two dispatches of one work-group per line:
+//   rows:    h0(k) -> h(k, t) (the updateFourier.frag step, fused into the load) -> row IFFT -> intermediate
+//   columns: intermediate -> column IFFT -> (re + im) * scale + offset (the rescaleHeight.frag step) -> height
+// Each line is transformed in shared memory, so N is limited by GL_MAX_COMPUTE_SHARED_MEMORY_SIZE
+// (2 * N complex floats, N = 2048 in the guaranteed 32 KiB).
+class GLComputeFFT {
+public:
+    GLComputeFFT();
+
+    // GL 4.3 (or ARB_compute_shader + ARB_shader_image_load_store) with a context current
+    static bool isSupported();
+
+    // Height = (re + im) * scale + offset, as in rescaleHeight.frag. Call before setup.
+    void setHeightScale(float scale, float offset);
+    // Compiles both passes for an N x N grid (power of two); false (with the reason on std::cerr) if N is not
+    // supported. patchSize is the side length L of the patch; omega is rounded down to a multiple of
+    // 2 pi / repeatTime, so every bin repeats after repeatTime seconds.
+    bool setup(size_t gridSize, float patchSize, float repeatTime);
+    void setPatchSize(float patchSize);
+
+    // h0Texture holds h0(k) (RG32F, as written by computeFourier.frag), intermediateTexture receives the row
+    // transform (RG32F) and heightTexture the height in its red channel (RG32F). All N x N. time is in
+    // [0, repeatTime).
+    void dispatch(GLuint h0Texture, GLuint intermediateTexture, GLuint heightTexture, float time);
+
+    // Deletes the GL objects while the context is current; there is no destructor, global instances outlive it
+    void cleanup();
+private:
+    size_t N;
+    float patchSize;
+    float heightScale;
+    float heightOffset;
+
+    ShaderProgram rowProgram;
+    ShaderProgram columnProgram;
+};
+
+#endif // GLCOMPUTEFFT_H
@@ -3,15 +3,35 @@
 
 #include <vector>
 #include <GL/glew.h>
+#ifdef __APPLE__
+#include <Accelerate/Accelerate.h>
+#else
+#include "CPUFFT.h"
+#endif
 
+// Inverse 2D FFT on the host: vDSP on macOS, the portable CPUFFT engine elsewhere. The plan and buffers are kept
+// between calls with the same gridSize, so repeated transforms allocate nothing.
 class IFFT {
 public:
     IFFT();
     ~IFFT();
 
+    // textureData and outputData hold 2 * gridSize^2 interleaved (re, im) floats; the result is scaled by
+    // 1 / gridSize^2 like clFFT's backward transform. gridSize must be a power of two.
+    void performIFFT(const GLfloat* textureData, GLfloat* outputData, size_t gridSize);
+    // performIFFT into a new vector
     std::vector<GLfloat> performIFFTFromTextureData(float* textureData, size_t gridSize);
+private:
+    size_t plannedSize;
+#ifdef __APPLE__
+    FFTSetup fftSetup;
+    std::vector<float> splitInput;  // All real parts, then all imaginary parts
+    std::vector<float> splitOutput;
+#else
+    CPUFFT engine;
+#endif
 
+    bool plan(size_t gridSize);
 };
 
 #endif // IFFT_H
-
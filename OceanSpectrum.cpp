@@ -0,0 +1,70 @@
+#include "OceanSpectrum.h"
+#include <cmath>
+
+namespace {
+
+// Philox-4x32 round multipliers and Weyl key increments
+const uint32_t philoxM0 = 0xD2511F53u;
+const uint32_t philoxM1 = 0xCD9E8D57u;
+const uint32_t philoxW0 = 0x9E3779B9u;
+const uint32_t philoxW1 = 0xBB67AE85u;
+
+// (0, 1] from the top 24 bits, exact in float
+float uniform(uint32_t bits) {
+    return (float) ((bits >> 8) + 1u) * (1.0f / 16777216.0f);
+}
+
+} // namespace
+
+OceanSpectrum::Counter OceanSpectrum::philox(Counter counter, Key key) {
+    for (int round = 0; round < 10; ++round) {
+        uint64_t product0 = (uint64_t) philoxM0 * counter[0];
+        uint64_t product1 = (uint64_t) philoxM1 * counter[2];
+        counter = {(uint32_t) (product1 >> 32) ^ counter[1] ^ key[0], (uint32_t) product1,
+                   (uint32_t) (product0 >> 32) ^ counter[3] ^ key[1], (uint32_t) product0};
+        key[0] += philoxW0;
+        key[1] += philoxW1;
+    }
+    return counter;
+}
+
+std::array<float, 2> OceanSpectrum::gaussianPair(uint32_t seed, uint32_t cascade, int32_t kx, int32_t ky) {
+    Counter bits = philox({(uint32_t) kx, (uint32_t) ky, 0u, 0u}, {seed, cascade});
+
+    // Box-Muller; u1 is never 0, so the log is finite
+    float radius = std::sqrt(-2.0f * std::log(uniform(bits[0])));
+    float theta = 2.0f * 3.14159265358979323846f * uniform(bits[1]);
+    return {radius * std::cos(theta), radius * std::sin(theta)};
+}
+
+void OceanSpectrum::generate(GLfloat* h0, size_t gridSize, float patchSize, uint32_t seed, uint32_t cascade,
+                             const Parameters& parameters) {
+    int N = (int) gridSize;
+    for (int y = 0; y < N; ++y) {
+        for (int x = 0; x < N; ++x) {
+            GLfloat* bin = h0 + 2 * ((size_t) y * gridSize + x);
+            int k_x = (x < N / 2) ? x : x - N; // 0, +ve, -ve
+            int k_y = (y < N / 2) ? y : y - N;
+
+            float kx = 2.0f * 3.14159265359f / patchSize * (float) k_x;
+            float ky = 2.0f * 3.14159265359f / patchSize * (float) k_y;
+            float k_mag = std::sqrt(kx * kx + ky * ky);
+            if (k_mag == 0.0f) {
+                bin[0] = bin[1] = 0.0f;
+                continue;
+            }
+
+            // JONSWAP spectrum
+            float sigma = (k_mag <= parameters.k_p) ? 0.07f : 0.09f;
+            float term1 = parameters.alpha * parameters.g * parameters.g / std::pow(k_mag, 5.0f);
+            float term2 = std::exp(-1.25f * std::pow(parameters.k_p / k_mag, 4.0f));
+            float term3 = std::pow(parameters.gamma,
+                                   std::exp(-0.5f * std::pow((k_mag / parameters.k_p - 1.0f) / sigma, 2.0f)));
+            float amplitude = std::sqrt(term1 * term2 * term3 / 2.0f);
+
+            std::array<float, 2> gaussian = gaussianPair(seed, cascade, k_x, k_y);
+            bin[0] = gaussian[0] * amplitude;
+            bin[1] = gaussian[1] * amplitude;
+        }
+    }
+}
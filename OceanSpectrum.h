@@ -0,0 +1,38 @@
+#ifndef OCEANSPECTRUM_H
+#define OCEANSPECTRUM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <GL/glew.h>
+
+// Initial ocean spectrum h0(k) on the host, the same as computeFourier.frag renders and oceanRandom.cl generates:
+// JONSWAP amplitudes times complex Gaussians drawn from Philox-4x32-10, a counter-based RNG keyed by (seed, cascade)
+// with the wave number (kx, ky) as the counter. Every bin is a pure function of those four integers, so any tile can
+// be regenerated on demand by whichever backend is free. The random bits and the uniforms made from them are
+// bit-exact across GLSL, OpenCL C and C++; the Box-Muller log/sqrt/cos/sin may differ in the last bits between
+// implementations.
+class OceanSpectrum {
+public:
+    // JONSWAP parameters, the uniforms of computeFourier.frag
+    struct Parameters {
+        float alpha = 0.0081f;
+        float g = 9.81f;
+        float k_p = 0.001f;  // Peak wave number
+        float gamma = 3.3f;  // Peak enhancement
+    };
+
+    typedef std::array<uint32_t, 4> Counter;
+    typedef std::array<uint32_t, 2> Key;
+
+    // Philox-4x32 with 10 rounds (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+    static Counter philox(Counter counter, Key key);
+    // Two independent standard normal values for wave number (kx, ky), by Box-Muller from the first two words
+    static std::array<float, 2> gaussianPair(uint32_t seed, uint32_t cascade, int32_t kx, int32_t ky);
+    // h0 for a patch of side patchSize: 2 * gridSize * gridSize floats in FFT order (index x is kx = x, or x - N from
+    // N / 2 on)
+    static void generate(GLfloat* h0, size_t gridSize, float patchSize, uint32_t seed, uint32_t cascade,
+                         const Parameters& parameters);
+};
+
+#endif // OCEANSPECTRUM_H
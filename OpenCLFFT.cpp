@@ -1,27 +1,143 @@
 #include "OpenCLFFT.h"
-#include <OpenCL/cl.h>
 #include <clFFT.h>
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <sstream>
 #include <GL/glew.h>
-#include <OpenGL/gl3.h>
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
 #include <OpenCL/cl_gl.h>
+#include <OpenGL/gl3.h>
+#include <OpenGL/OpenGL.h>
+#else
+#include <CL/cl.h>
+#include <CL/cl_gl.h>
+#include <GL/glx.h>
+#endif
 #include <cfloat>
+#include <algorithm>
 
-OpenCLFFT::OpenCLFFT() : queue(nullptr), context(nullptr), fftPlan(0) {}
+OpenCLFFT::OpenCLFFT() : context(nullptr), queue(nullptr), transferQueue(nullptr), device(nullptr), tmpBuffer(nullptr),
+                         fftPlan(0), engine(Engine::ClFFT), fftProgram(nullptr), rowKernel(nullptr),
+                         columnKernel(nullptr), twiddleBuffer(nullptr), fftGroupSize(0), bandLimit(0), gridSize(0),
+                         bufferSize(0), outputSize(0), resultFormat(GL_RG), resultLayers(1), latency(0),
+                         submittedFrames(0), presentedFrames(0), spectrumReleased(nullptr), glSharingContext(false),
+                         hostUnifiedMemory(false), transferPath(TransferPath::HostCopy), bytesTransferred(0),
+                         spectrumTexture(0), resultTexture(0), spectrumImage(nullptr), createEventFromGLSync(nullptr),
+                         evolveSpectrum(false), spectrumMode(SpectrumMode::FullComplex),
+                         pairedField(SpectralField::DisplacementX), choppiness(1.0f), patchSize(0.0f),
+                         repeatTime(1.0f), time(0.0f), spectrumBuffer(nullptr), paramsBuffer(nullptr),
+                         spectrumProgram(nullptr), spectrumKernel(nullptr), postProcessHeights(false),
+                         heightScale(1.0f), heightOffset(0.0f), statsProgram(nullptr), statsKernel(nullptr),
+                         statsBuffer(nullptr), statsGroups(0), statsCascades(1), heightStats{} {}
+
+// Work-group size of the heightStats kernel
+static const size_t statsGroupSize = 256;
+// OpenCLFFT instances holding a clFFT plan; the library is set up for the first and torn down after the last
+static int clfftUsers = 0;
+// Largest work-group of the Stockham kernels; each work-item runs one radix-4 butterfly per stage
+static const size_t maxFFTGroupSize = 256;
+
+// Function to read OpenCL source from file
+static std::string readKernelSource(const std::string& filePath) {
+    std::ifstream file(filePath);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
 
 OpenCLFFT::~OpenCLFFT() {
-    cleanup();
+    // Global instances are destroyed after the GL context; the owner has deleted the GL objects through cleanup()
+    releaseCLObjects();
+}
+
+void OpenCLFFT::releaseEvent(cl_event& event) {
+    if (event) clReleaseEvent(event);
+    event = nullptr;
 }
 
 void OpenCLFFT::cleanup() {
-//    if (inputBuffer) clReleaseMemObject(inputBuffer);
-//    if (outputBuffer) clReleaseMemObject(outputBuffer);
+    // Nothing may still be in flight when the buffers go away
+    if (queue) clFinish(queue);
+    if (transferQueue) clFinish(transferQueue);
+
+    // The CL views go before the GL buffers they alias
+    for (FrameSlot& slot : slots) {
+        if (slot.resultSharedBuffer) clReleaseMemObject(slot.resultSharedBuffer);
+        if (slot.unpackFence) glDeleteSync(slot.unpackFence);
+        if (slot.spectrumFence) glDeleteSync(slot.spectrumFence);
+        if (slot.resultPixelBuffer) glDeleteBuffers(1, &slot.resultPixelBuffer);
+        slot.resultSharedBuffer = nullptr;
+        slot.unpackFence = nullptr;
+        slot.spectrumFence = nullptr;
+        slot.resultPixelBuffer = 0;
+    }
+    if (spectrumImage) clReleaseMemObject(spectrumImage);
+    spectrumImage = nullptr;
+
+    releaseCLObjects();
+}
+
+void OpenCLFFT::releaseCLObjects() {
+    if (queue) clFinish(queue);
+    if (transferQueue) clFinish(transferQueue);
+
+    for (FrameSlot& slot : slots) {
+        releaseEvent(slot.inputFree);
+        releaseEvent(slot.outputFree);
+        releaseEvent(slot.done);
+        releaseEvent(slot.resultRead);
+        releaseEvent(slot.statsReady);
+        if (slot.resultSharedBuffer) clReleaseMemObject(slot.resultSharedBuffer);
+        if (slot.inputBuffer) clReleaseMemObject(slot.inputBuffer);
+        if (slot.outputBuffer) clReleaseMemObject(slot.outputBuffer);
+    }
+    slots.clear();
+    releaseEvent(spectrumReleased);
+
+    if (spectrumImage) clReleaseMemObject(spectrumImage);
+    if (spectrumBuffer) clReleaseMemObject(spectrumBuffer);
+    if (paramsBuffer) clReleaseMemObject(paramsBuffer);
+    if (spectrumKernel) clReleaseKernel(spectrumKernel);
+    if (spectrumProgram) clReleaseProgram(spectrumProgram);
+    if (statsBuffer) clReleaseMemObject(statsBuffer);
+    if (statsKernel) clReleaseKernel(statsKernel);
+    if (statsProgram) clReleaseProgram(statsProgram);
+    if (twiddleBuffer) clReleaseMemObject(twiddleBuffer);
+    if (rowKernel) clReleaseKernel(rowKernel);
+    if (columnKernel) clReleaseKernel(columnKernel);
+    if (fftProgram) clReleaseProgram(fftProgram);
+    if (tmpBuffer) clReleaseMemObject(tmpBuffer);
+    if (transferQueue) clReleaseCommandQueue(transferQueue);
     if (queue) clReleaseCommandQueue(queue);
     if (context) clReleaseContext(context);
-    if (fftPlan) clfftDestroyPlan(&fftPlan);
-    clfftTeardown();
+    if (fftPlan) {
+        clfftDestroyPlan(&fftPlan);
+        if (--clfftUsers == 0) {
+            clfftTeardown();
+        }
+    }
+    spectrumImage = nullptr;
+    spectrumBuffer = nullptr;
+    paramsBuffer = nullptr;
+    spectrumKernel = nullptr;
+    spectrumProgram = nullptr;
+    statsBuffer = nullptr;
+    statsKernel = nullptr;
+    statsProgram = nullptr;
+    twiddleBuffer = nullptr;
+    rowKernel = nullptr;
+    columnKernel = nullptr;
+    fftProgram = nullptr;
+    tmpBuffer = nullptr;
+    transferQueue = nullptr;
+    queue = nullptr;
+    context = nullptr;
+    fftPlan = 0;
 }
 
 void OpenCLFFT::checkError(cl_int err, const char* operation) {
@@ -32,95 +148,903 @@ void OpenCLFFT::checkError(cl_int err, const char* operation) {
     }
 }
 
+cl_int OpenCLFFT::pickDevice(cl_platform_id& platform, cl_device_id& device) {
+    cl_int err = clGetPlatformIDs(1, &platform, nullptr);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // Prefer a GPU, but accept any device (e.g. pocl on render nodes without one)
+    if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, nullptr) != CL_SUCCESS) {
+        err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 1, &device, nullptr);
+    }
+    return err;
+}
+
+std::string OpenCLFFT::deviceExtensions(cl_device_id device) {
+    size_t extensionsSize = 0;
+    clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, nullptr, &extensionsSize);
+    std::string extensions(extensionsSize, '\0');
+    clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, extensionsSize, &extensions[0], nullptr);
+    return extensions;
+}
+
+bool OpenCLFFT::deviceSharesGL() {
+    cl_platform_id platform;
+    cl_device_id device;
+    if (pickDevice(platform, device) != CL_SUCCESS) {
+        return false;
+    }
+    std::string extensions = deviceExtensions(device);
+    return extensions.find("cl_khr_gl_sharing") != std::string::npos ||
+           extensions.find("cl_APPLE_gl_sharing") != std::string::npos;
+}
+
+void OpenCLFFT::createContext(cl_platform_id platform) {
+    cl_int err;
+
+    // Share the current GL context's objects if the device supports it
+    std::string extensions = deviceExtensions(device);
+    bool sharingSupported = extensions.find("cl_khr_gl_sharing") != std::string::npos ||
+                            extensions.find("cl_APPLE_gl_sharing") != std::string::npos;
+
+    if (sharingSupported) {
+#ifdef __APPLE__
+        CGLContextObj glContext = CGLGetCurrentContext();
+        CGLShareGroupObj shareGroup = glContext ? CGLGetShareGroup(glContext) : nullptr;
+        cl_context_properties properties[] = {
+                CL_CONTEXT_PROPERTY_USE_CGL_SHAREGROUP_APPLE, (cl_context_properties) shareGroup,
+                0
+        };
+        bool haveGLContext = shareGroup != nullptr;
+#else
+        cl_context_properties properties[] = {
+                CL_GL_CONTEXT_KHR, (cl_context_properties) glXGetCurrentContext(),
+                CL_GLX_DISPLAY_KHR, (cl_context_properties) glXGetCurrentDisplay(),
+                CL_CONTEXT_PLATFORM, (cl_context_properties) platform,
+                0
+        };
+        bool haveGLContext = glXGetCurrentContext() != nullptr;
+#endif
+        if (haveGLContext) {
+            context = clCreateContext(properties, 1, &device, nullptr, nullptr, &err);
+            glSharingContext = err == CL_SUCCESS;
+        }
+    }
+
+#ifndef __APPLE__
+    if (glSharingContext && extensions.find("cl_khr_gl_event") != std::string::npos) {
+        createEventFromGLSync = (CreateEventFromGLSync) clGetExtensionFunctionAddressForPlatform(
+                platform, "clCreateEventFromGLsyncKHR");
+    }
+#endif
+
+    if (!glSharingContext) {
+        // Use default context creation
+        context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+        checkError(err, "clCreateContext");
+    }
+}
+
+void OpenCLFFT::setPipelineLatency(int frames) {
+    if (frames < 0 || frames > 2) {
+        std::cerr << "Pipeline latency must be 0, 1 or 2 frames, got " << frames << std::endl;
+        frames = frames < 0 ? 0 : 2;
+    }
+    latency = frames;
+}
+
+void OpenCLFFT::setEngine(Engine engine) {
+    this->engine = engine;
+}
+
+OpenCLFFT::Engine OpenCLFFT::getEngine() const {
+    return engine;
+}
+
+void OpenCLFFT::setBandLimit(size_t band) {
+    bandLimit = band;
+}
+
+void OpenCLFFT::enableSpectrumEvolution(float patchSize, float repeatTime) {
+    evolveSpectrum = true;
+    this->patchSize = patchSize;
+    this->repeatTime = repeatTime;
+}
+
+void OpenCLFFT::setSpectrumMode(SpectrumMode mode, SpectralField pairedField) {
+    spectrumMode = mode;
+    this->pairedField = pairedField;
+}
+
+void OpenCLFFT::setChoppiness(float choppiness) {
+    this->choppiness = choppiness;
+}
+
+void OpenCLFFT::setCascades(const std::vector<float>& patchSizes) {
+    cascadeSizes = patchSizes;
+}
+
+size_t OpenCLFFT::getCascadeCount() const {
+    return cascadeSizes.size();
+}
+
+size_t OpenCLFFT::getResultLayers() const {
+    return resultLayers;
+}
+
+void OpenCLFFT::enableHeightPostProcessing(float scale, float offset) {
+    postProcessHeights = true;
+    heightScale = scale;
+    heightOffset = offset;
+}
+
+std::string OpenCLFFT::buildCallbackSource() const {
+    // showpoint so that whole-number sizes still form valid float literals (100.000f, not 100f)
+    std::ostringstream source;
+    source << std::showpoint
+           << "#define OCEAN_N " << gridSize << "\n"
+           << "#define OCEAN_L " << patchSize << "f\n"
+           << "#define OCEAN_G 9.81f\n"
+           << "#define OCEAN_REPEAT_TIME " << repeatTime << "f\n";
+    if (spectrumMode == SpectrumMode::PackedPair) {
+        source << "#define OCEAN_PAIR_FIRST " << (int) SpectralField::Height << "\n"
+               << "#define OCEAN_PAIR_SECOND " << (int) pairedField << "\n";
+    } else if (spectrumMode == SpectrumMode::BatchedFields) {
+        // Cascade c keeps |k| in [boundary(c - 1), boundary(c)). The boundary sits a few fundamentals into the next
+        // (smaller) patch, but never past this patch's Nyquist wavenumber.
+        std::ostringstream patchList, kMinList, kMaxList;
+        patchList << std::showpoint;
+        kMinList << std::showpoint;
+        kMaxList << std::showpoint;
+        float kMin = 0.0f;
+        for (size_t c = 0; c < cascadeSizes.size(); ++c) {
+            float kMax = 1e30f;
+            if (c + 1 < cascadeSizes.size()) {
+                float nyquist = (float) M_PI * gridSize / cascadeSizes[c];
+                kMax = std::min(4.0f * 2.0f * (float) M_PI / cascadeSizes[c + 1], nyquist);
+            }
+            const char* separator = c ? ", " : "";
+            patchList << separator << cascadeSizes[c] << "f";
+            kMinList << separator << kMin << "f";
+            kMaxList << separator << kMax << "f";
+            kMin = kMax;
+        }
+        source << "#define OCEAN_BATCHED_FIELDS\n"
+               << "#define OCEAN_CASCADES " << cascadeSizes.size() << "\n"
+               << "#define OCEAN_CASCADE_L {" << patchList.str() << "}\n"
+               << "#define OCEAN_CASCADE_K_MIN {" << kMinList.str() << "}\n"
+               << "#define OCEAN_CASCADE_K_MAX {" << kMaxList.str() << "}\n";
+    }
+    source << readKernelSource("../oceanCallbacks.cl");
+    return source.str();
+}
+
+void OpenCLFFT::setupCallbacks() {
+    cl_int err;
+
+    paramsBuffer = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(cl_float) * 4, nullptr, &err);
+    checkError(err, "clCreateBuffer (params)");
+
+    // The Stockham kernels call the same functions directly instead of through plan callbacks
+    std::string callbackSource = fftPlan ? buildCallbackSource() : std::string();
+
+    const char* preCallback = "oceanEvolveSpectrum";
+    const char* postCallback = "oceanStoreHeight";
+    if (spectrumMode == SpectrumMode::HermitianReal) {
+        preCallback = "oceanEvolveHermitian";
+        postCallback = "oceanStoreRealHeight";
+    } else if (spectrumMode == SpectrumMode::PackedPair) {
+        preCallback = "oceanEvolvePair";
+        postCallback = "oceanStorePair";
+    } else if (spectrumMode == SpectrumMode::BatchedFields) {
+        preCallback = "oceanEvolveBatch";
+        postCallback = "oceanStoreBatch";
+    }
+
+    if (evolveSpectrum) {
+        // A batched plan expects one input plane per batch; only the first holds h0, the callback reads it for all
+        spectrumBuffer = clCreateBuffer(context, CL_MEM_READ_ONLY, bufferSize * resultLayers, nullptr, &err);
+        checkError(err, "clCreateBuffer (spectrum)");
+    }
+
+    if (evolveSpectrum && fftPlan) {
+        checkError(clfftSetPlanCallback(fftPlan, preCallback, callbackSource.c_str(), 0, PRECALLBACK, &paramsBuffer, 1),
+                   "clfftSetPlanCallback (pre)");
+    }
+
+    if (postProcessHeights) {
+        if (fftPlan) {
+            checkError(clfftSetPlanCallback(fftPlan, postCallback, callbackSource.c_str(), 0, POSTCALLBACK, &paramsBuffer, 1),
+                       "clfftSetPlanCallback (post)");
+        }
+        setupHeightStats();
+    }
+}
+
+void OpenCLFFT::setupHeightStats() {
+    cl_int err;
+
+    // Batched results hold every cascade's height layer; shader.vert sums them
+    statsCascades = spectrumMode == SpectrumMode::BatchedFields ? cascadeSizes.size() : 1;
+
+    std::ostringstream source;
+    source << "#define STATS_GROUP_SIZE " << statsGroupSize << "\n"
+           << "#define STATS_COUNT " << gridSize * gridSize << "\n"
+           << "#define STATS_STRIDE " << (resultFormat == GL_RED ? 1 : 2) << "\n"
+           << "#define STATS_CASCADE_STRIDE " << outputSize / sizeof(cl_float) / statsCascades << "\n"
+           << readKernelSource("../heightStats.cl");
+    std::string kernelSource = source.str();
+    const char* kernelSourcePtr = kernelSource.c_str();
+
+    statsProgram = clCreateProgramWithSource(context, 1, &kernelSourcePtr, nullptr, &err);
+    checkError(err, "clCreateProgramWithSource (heightStats)");
+
+    err = clBuildProgram(statsProgram, 1, &device, nullptr, nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        char buildLog[4096];
+        clGetProgramBuildInfo(statsProgram, device, CL_PROGRAM_BUILD_LOG, sizeof(buildLog), buildLog, nullptr);
+        std::cerr << "heightStats.cl build failed: " << buildLog << std::endl;
+    }
+    checkError(err, "clBuildProgram (heightStats)");
+
+    statsKernel = clCreateKernel(statsProgram, "heightStats", &err);
+    checkError(err, "clCreateKernel (heightStats)");
+
+    // Enough groups to fill the device; each work-item strides over the grid
+    statsGroups = std::max<size_t>(1, std::min<size_t>(256, gridSize * gridSize / statsGroupSize));
+    statsBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_float) * 4 * statsGroups * statsCascades, nullptr,
+                                 &err);
+    checkError(err, "clCreateBuffer (stats)");
+}
+
+void OpenCLFFT::setupSpectrumGenerator() {
+    cl_int err;
+
+    std::ostringstream source;
+    source << "#define OCEAN_N " << gridSize << "\n"
+           << readKernelSource("../oceanRandom.cl");
+    std::string kernelSource = source.str();
+    const char* kernelSourcePtr = kernelSource.c_str();
+
+    spectrumProgram = clCreateProgramWithSource(context, 1, &kernelSourcePtr, nullptr, &err);
+    checkError(err, "clCreateProgramWithSource (oceanRandom)");
+
+    err = clBuildProgram(spectrumProgram, 1, &device, nullptr, nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        char buildLog[4096];
+        clGetProgramBuildInfo(spectrumProgram, device, CL_PROGRAM_BUILD_LOG, sizeof(buildLog), buildLog, nullptr);
+        std::cerr << "oceanRandom.cl build failed: " << buildLog << std::endl;
+    }
+    checkError(err, "clBuildProgram (oceanRandom)");
+
+    spectrumKernel = clCreateKernel(spectrumProgram, "oceanInitialSpectrum", &err);
+    checkError(err, "clCreateKernel (oceanInitialSpectrum)");
+}
+
+bool OpenCLFFT::setupStockham() {
+    cl_int err;
+
+    // Step 1: Check the grid and mode against what the kernels handle
+    int log2N = 0;
+    while ((size_t(1) << log2N) < gridSize) {
+        ++log2N;
+    }
+    cl_ulong localMemory = 0;
+    size_t maxGroupSize = 0;
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localMemory, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &maxGroupSize, nullptr);
+    if (spectrumMode != SpectrumMode::FullComplex) {
+        std::cerr << "Stockham IFFT only handles the full complex spectrum, using clFFT" << std::endl;
+        return false;
+    }
+    if (gridSize < 2 || (size_t(1) << log2N) != gridSize || 2 * gridSize * sizeof(cl_float2) > localMemory) {
+        std::cerr << "Stockham IFFT needs a power of two grid whose line fits twice in local memory, using clFFT" << std::endl;
+        return false;
+    }
+    fftGroupSize = std::max<size_t>(1, std::min(std::min(gridSize / 4, maxFFTGroupSize), maxGroupSize));
+
+    // Step 2: Twiddles exp(2 * pi * i * t / N), computed once in double precision
+    std::vector<cl_float2> twiddles(gridSize);
+    for (size_t t = 0; t < gridSize; ++t) {
+        double angle = 2.0 * M_PI * (double) t / (double) gridSize;
+        twiddles[t].s[0] = (cl_float) std::cos(angle);
+        twiddles[t].s[1] = (cl_float) std::sin(angle);
+    }
+    twiddleBuffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(cl_float2) * gridSize,
+                                   twiddles.data(), &err);
+    checkError(err, "clCreateBuffer (twiddles)");
+
+    // Step 3: Build the row and column kernels on top of the callback functions
+    std::ostringstream source;
+    source << "#define OCEAN_FFT_GROUP_SIZE " << fftGroupSize << "\n";
+    if (log2N % 2) source << "#define OCEAN_FFT_RADIX2\n";
+    if (evolveSpectrum) source << "#define OCEAN_FFT_EVOLVE\n";
+    if (postProcessHeights) source << "#define OCEAN_FFT_STORE_HEIGHT\n";
+    source << buildCallbackSource() << readKernelSource("../fft_kernel.cl");
+    std::string kernelSource = source.str();
+    const char* kernelSourcePtr = kernelSource.c_str();
+
+    fftProgram = clCreateProgramWithSource(context, 1, &kernelSourcePtr, nullptr, &err);
+    checkError(err, "clCreateProgramWithSource (fft_kernel)");
+
+    err = clBuildProgram(fftProgram, 1, &device, nullptr, nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        char buildLog[4096];
+        clGetProgramBuildInfo(fftProgram, device, CL_PROGRAM_BUILD_LOG, sizeof(buildLog), buildLog, nullptr);
+        std::cerr << "fft_kernel.cl build failed: " << buildLog << std::endl;
+    }
+    checkError(err, "clBuildProgram (fft_kernel)");
+
+    rowKernel = clCreateKernel(fftProgram, "oceanIFFTRows", &err);
+    checkError(err, "clCreateKernel (oceanIFFTRows)");
+    columnKernel = clCreateKernel(fftProgram, "oceanIFFTColumns", &err);
+    checkError(err, "clCreateKernel (oceanIFFTColumns)");
+    return true;
+}
+
+void OpenCLFFT::enqueueTransform(cl_mem input, cl_mem output, cl_uint waitCount, cl_event* waitEvents, cl_event* event) {
+    cl_int err;
+
+    if (engine == Engine::ClFFT) {
+        err = clfftEnqueueTransform(fftPlan, CLFFT_BACKWARD, 1, &queue, waitCount, waitCount ? waitEvents : nullptr, event,
+                                    &input, &output, tmpBuffer);
+        checkError(err, "clfftEnqueueTransform (IFFT)");
+        return;
+    }
+
+    // Rows into tmpBuffer, then columns into output; the in-order queue keeps the two passes in sequence. Only the
+    // 2 * band rows that can be nonzero are transformed.
+    cl_int band = (cl_int) (bandLimit && bandLimit < gridSize / 2 ? bandLimit : gridSize / 2);
+    size_t localSize = fftGroupSize;
+    size_t rowsSize = 2 * band * fftGroupSize;
+    size_t globalSize = gridSize * fftGroupSize;
+    checkError(clSetKernelArg(rowKernel, 0, sizeof(cl_mem), &input), "clSetKernelArg (rows input)");
+    checkError(clSetKernelArg(rowKernel, 1, sizeof(cl_mem), &tmpBuffer), "clSetKernelArg (rows scratch)");
+    checkError(clSetKernelArg(rowKernel, 2, sizeof(cl_mem), &twiddleBuffer), "clSetKernelArg (rows twiddles)");
+    checkError(clSetKernelArg(rowKernel, 3, sizeof(cl_mem), &paramsBuffer), "clSetKernelArg (rows params)");
+    checkError(clSetKernelArg(rowKernel, 4, sizeof(cl_int), &band), "clSetKernelArg (rows band)");
+    err = clEnqueueNDRangeKernel(queue, rowKernel, 1, nullptr, &rowsSize, &localSize, waitCount,
+                                 waitCount ? waitEvents : nullptr, nullptr);
+    checkError(err, "clEnqueueNDRangeKernel (oceanIFFTRows)");
+
+    checkError(clSetKernelArg(columnKernel, 0, sizeof(cl_mem), &tmpBuffer), "clSetKernelArg (columns scratch)");
+    checkError(clSetKernelArg(columnKernel, 1, sizeof(cl_mem), &output), "clSetKernelArg (columns output)");
+    checkError(clSetKernelArg(columnKernel, 2, sizeof(cl_mem), &twiddleBuffer), "clSetKernelArg (columns twiddles)");
+    checkError(clSetKernelArg(columnKernel, 3, sizeof(cl_mem), &paramsBuffer), "clSetKernelArg (columns params)");
+    checkError(clSetKernelArg(columnKernel, 4, sizeof(cl_int), &band), "clSetKernelArg (columns band)");
+    err = clEnqueueNDRangeKernel(queue, columnKernel, 1, nullptr, &globalSize, &localSize, 0, nullptr, event);
+    checkError(err, "clEnqueueNDRangeKernel (oceanIFFTColumns)");
+}
+
+void OpenCLFFT::uploadInitialSpectrum(const GLfloat* h0, size_t cascade) {
+    if (cascade >= cascadeSizes.size()) {
+        std::cerr << "No spectrum cascade " << cascade << std::endl;
+        return;
+    }
+
+    // Each cascade's h0 sits in the first input plane of its group of batches
+    size_t offset = cascade * (resultLayers / cascadeSizes.size()) * bufferSize;
+    cl_int err = clEnqueueWriteBuffer(queue, spectrumBuffer, CL_TRUE, offset, bufferSize, h0, 0, nullptr, nullptr);
+    checkError(err, "clEnqueueWriteBuffer (spectrum)");
+}
+
+void OpenCLFFT::generateInitialSpectrum(size_t cascade, cl_uint seed, const OceanSpectrum::Parameters& parameters) {
+    if (cascade >= cascadeSizes.size() || !spectrumBuffer) {
+        std::cerr << "No spectrum cascade " << cascade << std::endl;
+        return;
+    }
+    if (!spectrumKernel) {
+        setupSpectrumGenerator();
+    }
+
+    // Same plane as uploadInitialSpectrum, in bins
+    cl_uint planeOffset = (cl_uint) (cascade * (resultLayers / cascadeSizes.size()) * gridSize * gridSize);
+    cl_float cascadePatchSize = cascadeSizes[cascade];
+    cl_uint cascadeKey = (cl_uint) cascade;
+    checkError(clSetKernelArg(spectrumKernel, 0, sizeof(cl_mem), &spectrumBuffer), "clSetKernelArg (spectrum h0)");
+    checkError(clSetKernelArg(spectrumKernel, 1, sizeof(cl_uint), &planeOffset), "clSetKernelArg (spectrum offset)");
+    checkError(clSetKernelArg(spectrumKernel, 2, sizeof(cl_float), &cascadePatchSize), "clSetKernelArg (spectrum L)");
+    checkError(clSetKernelArg(spectrumKernel, 3, sizeof(cl_uint), &seed), "clSetKernelArg (spectrum seed)");
+    checkError(clSetKernelArg(spectrumKernel, 4, sizeof(cl_uint), &cascadeKey), "clSetKernelArg (spectrum cascade)");
+    checkError(clSetKernelArg(spectrumKernel, 5, sizeof(cl_float), &parameters.alpha), "clSetKernelArg (spectrum alpha)");
+    checkError(clSetKernelArg(spectrumKernel, 6, sizeof(cl_float), &parameters.g), "clSetKernelArg (spectrum g)");
+    checkError(clSetKernelArg(spectrumKernel, 7, sizeof(cl_float), &parameters.k_p), "clSetKernelArg (spectrum k_p)");
+    checkError(clSetKernelArg(spectrumKernel, 8, sizeof(cl_float), &parameters.gamma), "clSetKernelArg (spectrum gamma)");
+
+    size_t globalSize[2] = {gridSize, gridSize};
+    cl_int err = clEnqueueNDRangeKernel(queue, spectrumKernel, 2, nullptr, globalSize, nullptr, 0, nullptr, nullptr);
+    checkError(err, "clEnqueueNDRangeKernel (oceanInitialSpectrum)");
+}
+
+void OpenCLFFT::setTime(float time) {
+    this->time = time;
+}
+
+void OpenCLFFT::writeParams(FrameSlot& slot) {
+    if (!paramsBuffer) {
+        return;
+    }
+
+    // Only these few floats cross the bus; the slot keeps the host copy alive until the write has run
+    slot.params[0] = time;
+    slot.params[1] = heightScale;
+    slot.params[2] = heightOffset;
+    slot.params[3] = choppiness;
+    cl_int err = clEnqueueWriteBuffer(queue, paramsBuffer, CL_FALSE, 0, sizeof(slot.params), slot.params, 0, nullptr, nullptr);
+    checkError(err, "clEnqueueWriteBuffer (params)");
+}
+
+void OpenCLFFT::enqueueHeightStats(FrameSlot& slot, cl_mem result) {
+    cl_int err;
+
+    checkError(clSetKernelArg(statsKernel, 0, sizeof(cl_mem), &result), "clSetKernelArg (heights)");
+    checkError(clSetKernelArg(statsKernel, 1, sizeof(cl_mem), &statsBuffer), "clSetKernelArg (partials)");
+
+    size_t localSize[2] = {statsGroupSize, 1};
+    size_t globalSize[2] = {statsGroups * statsGroupSize, statsCascades};
+    releaseEvent(slot.resultRead);
+    err = clEnqueueNDRangeKernel(queue, statsKernel, 2, nullptr, globalSize, localSize, 0, nullptr, &slot.resultRead);
+    checkError(err, "clEnqueueNDRangeKernel (heightStats)");
+
+    // A few KB of partials instead of a CPU scan over the whole field
+    slot.statsPartials.resize(4 * statsGroups * statsCascades);
+    releaseEvent(slot.statsReady);
+    err = clEnqueueReadBuffer(queue, statsBuffer, CL_FALSE, 0, sizeof(cl_float) * slot.statsPartials.size(),
+                              slot.statsPartials.data(), 0, nullptr, &slot.statsReady);
+    checkError(err, "clEnqueueReadBuffer (stats)");
+}
+
+void OpenCLFFT::foldHeightStats(FrameSlot& slot) {
+    checkError(clWaitForEvents(1, &slot.statsReady), "clWaitForEvents (stats)");
+    releaseEvent(slot.statsReady);
+
+    // The surface is the sum of the cascades (shader.vert), so their extremes add up
+    double count = (double) gridSize * gridSize;
+    HeightStats total = {};
+    double meanSquare = 0.0;
+    for (size_t cascade = 0; cascade < statsCascades; ++cascade) {
+        float minVal = FLT_MAX;
+        float maxVal = -FLT_MAX;
+        double sum = 0.0;
+        double sumSq = 0.0;
+        for (size_t group = 0; group < statsGroups; ++group) {
+            const cl_float* partial = &slot.statsPartials[4 * (cascade * statsGroups + group)];
+            minVal = std::min(minVal, partial[0]);
+            maxVal = std::max(maxVal, partial[1]);
+            sum += partial[2];
+            sumSq += partial[3];
+        }
+        double mean = sum / count;
+        total.min += minVal;
+        total.max += maxVal;
+        total.mean += (float) mean;
+        // Variances of uncorrelated cascades add
+        meanSquare += sumSq / count - mean * mean;
+    }
+    total.rms = (float) std::sqrt(meanSquare + (double) total.mean * total.mean);
+    heightStats = total;
+}
+
+OpenCLFFT::HeightStats OpenCLFFT::getHeightStats() const {
+    return heightStats;
+}
+
 void OpenCLFFT::setup(size_t gridSize) {
     cl_int err;
-    static bool clfft_initialized = false;
-    if (!clfft_initialized) {
-        clfftSetupData fftSetup;
-        clfftInitSetupData(&fftSetup);
-        checkError(clfftSetup(&fftSetup), "clfftSetup");
-        clfft_initialized = true;
+    this->gridSize = gridSize;
+    bufferSize = sizeof(GLfloat) * 2 * gridSize * gridSize;
+
+    // Only the pre-callback can turn h0(k) into a Hermitian spectrum
+    if (spectrumMode != SpectrumMode::FullComplex && !evolveSpectrum) {
+        std::cerr << "Hermitian spectrum modes need spectrum evolution, using the complex transform" << std::endl;
+        spectrumMode = SpectrumMode::FullComplex;
     }
+    resultFormat = spectrumMode == SpectrumMode::HermitianReal ? GL_RED : GL_RG;
+    if (cascadeSizes.empty() || cascadeSizes.size() > maxCascades ||
+        (cascadeSizes.size() > 1 && spectrumMode != SpectrumMode::BatchedFields)) {
+        if (cascadeSizes.size() > 1) {
+            std::cerr << "Cascades need the batched field mode and at most " << maxCascades << " patches, using one" << std::endl;
+        }
+        cascadeSizes.assign(1, patchSize);
+    }
+    resultLayers = spectrumMode == SpectrumMode::BatchedFields ? fieldLayers * cascadeSizes.size() : 1;
+    outputSize = (resultFormat == GL_RED ? bufferSize / 2 : bufferSize) * resultLayers;
 
     // Get platform and device info
     cl_platform_id platform;
-    checkError(clGetPlatformIDs(1, &platform, nullptr), "clGetPlatformIDs");
-
-    cl_device_id device;
-    checkError(clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, nullptr), "clGetDeviceIDs");
+    checkError(pickDevice(platform, device), "clGetDeviceIDs");
 
     cl_device_type deviceType;
     clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(cl_device_type), &deviceType, nullptr);
 
-    // Use default context creation
-    context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
-    checkError(err, "clCreateContext");
+    cl_bool unified = CL_FALSE;
+    clGetDeviceInfo(device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &unified, nullptr);
+    hostUnifiedMemory = unified == CL_TRUE || deviceType == CL_DEVICE_TYPE_CPU;
+
+    createContext(platform);
 
     queue = clCreateCommandQueue(context, device, 0, &err);
     checkError(err, "clCreateCommandQueue");
 
-    // Create FFT plan
-    size_t fftDims[2] = {gridSize, gridSize};
-    checkError(clfftCreateDefaultPlan(&fftPlan, context, CLFFT_2D, fftDims), "clfftCreateDefaultPlan");
-    checkError(clfftSetPlanPrecision(fftPlan, CLFFT_SINGLE), "clfftSetPlanPrecision");
-    checkError(clfftSetLayout(fftPlan, CLFFT_COMPLEX_INTERLEAVED, CLFFT_COMPLEX_INTERLEAVED), "clfftSetLayout");
-    checkError(clfftSetResultLocation(fftPlan, CLFFT_OUTOFPLACE), "clfftSetResultLocation");
-    checkError(clfftBakePlan(fftPlan, 1, &queue, nullptr, nullptr), "clfftBakePlan");
+    transferQueue = clCreateCommandQueue(context, device, 0, &err);
+    checkError(err, "clCreateCommandQueue (transfer)");
+
+    if (engine == Engine::Stockham && !setupStockham()) {
+        engine = Engine::ClFFT;
+    }
+    if (engine == Engine::Stockham) {
+        setupCallbacks();
+    } else {
+        if (clfftUsers == 0) {
+            clfftSetupData fftSetup;
+            clfftInitSetupData(&fftSetup);
+            checkError(clfftSetup(&fftSetup), "clfftSetup");
+        }
+
+        // Create FFT plan
+        size_t fftDims[2] = {gridSize, gridSize};
+        checkError(clfftCreateDefaultPlan(&fftPlan, context, CLFFT_2D, fftDims), "clfftCreateDefaultPlan");
+        clfftUsers++;
+        checkError(clfftSetPlanPrecision(fftPlan, CLFFT_SINGLE), "clfftSetPlanPrecision");
+        checkError(clfftSetResultLocation(fftPlan, CLFFT_OUTOFPLACE), "clfftSetResultLocation");
+        if (spectrumMode == SpectrumMode::HermitianReal) {
+            // The height is real, so only the N/2 + 1 non-redundant columns are transformed. The input strides keep
+            // the row pitch of the full h0 buffer so the pre-callback can also read h0(-k) from it.
+            size_t strides[2] = {1, gridSize};
+            checkError(clfftSetLayout(fftPlan, CLFFT_HERMITIAN_INTERLEAVED, CLFFT_REAL), "clfftSetLayout");
+            checkError(clfftSetPlanInStride(fftPlan, CLFFT_2D, strides), "clfftSetPlanInStride");
+            checkError(clfftSetPlanOutStride(fftPlan, CLFFT_2D, strides), "clfftSetPlanOutStride");
+            checkError(clfftSetPlanDistance(fftPlan, gridSize * gridSize, gridSize * gridSize), "clfftSetPlanDistance");
+        } else {
+            checkError(clfftSetLayout(fftPlan, CLFFT_COMPLEX_INTERLEAVED, CLFFT_COMPLEX_INTERLEAVED), "clfftSetLayout");
+        }
+        if (resultLayers > 1) {
+            // All fields in one launch sequence; each batch is one contiguous layer of the result
+            checkError(clfftSetPlanBatchSize(fftPlan, resultLayers), "clfftSetPlanBatchSize");
+            checkError(clfftSetPlanDistance(fftPlan, gridSize * gridSize, gridSize * gridSize), "clfftSetPlanDistance");
+        }
+        if (evolveSpectrum || postProcessHeights) {
+            setupCallbacks();
+        }
+        checkError(clfftBakePlan(fftPlan, 1, &queue, nullptr, nullptr), "clfftBakePlan");
+    }
+
+    // Device buffers and host staging live for the lifetime of the plan and are reused every frame.
+    // Host-allocated backing lets performIFFTInterop map them instead of copying.
+    slots.assign(latency + 1, FrameSlot{});
+    for (FrameSlot& slot : slots) {
+        slot.inputBuffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, bufferSize, nullptr, &err);
+        checkError(err, "clCreateBuffer (input)");
+
+        slot.outputBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, outputSize, nullptr, &err);
+        checkError(err, "clCreateBuffer (output)");
+    }
+
+    // Multi-pass plans need scratch space; hand clFFT our own so it never allocates during a transform. The
+    // Stockham row pass writes one complex grid into it for the column pass.
+    size_t tmpSize = bufferSize;
+    if (fftPlan) {
+        checkError(clfftGetTmpBufSize(fftPlan, &tmpSize), "clfftGetTmpBufSize");
+    }
+    if (tmpSize > 0) {
+        tmpBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, tmpSize, nullptr, &err);
+        checkError(err, "clCreateBuffer (tmp)");
+    }
+
+    stagingData.assign(2 * gridSize * gridSize, 0.0f);
 }
 
-GLfloat* OpenCLFFT::performIFFTFromOpenGLTexture(GLfloat* textureData, size_t gridSize) {
-    cl_int err;
+GLfloat* OpenCLFFT::getStagingBuffer() {
+    return stagingData.data();
+}
+
+void OpenCLFFT::performIFFTFromOpenGLTexture(const GLfloat* textureData, GLfloat* outputData, size_t outputSize) {
+    if (outputSize * sizeof(GLfloat) < this->outputSize) {
+        std::cerr << "IFFT output buffer too small: " << outputSize << " floats" << std::endl;
+        return;
+    }
 
-    // Step 1: Create an OpenCL buffer for FFT input data
-    cl_mem inputClBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(GLfloat) * 2 * gridSize * gridSize, nullptr, &err);
-    checkError(err, "clCreateBuffer (input)");
+    cl_int err;
 
-    // Step 2: Copy the texture data into the OpenCL buffer
-    err = clEnqueueWriteBuffer(queue, inputClBuffer, CL_TRUE, 0, sizeof(GLfloat) * 2 * gridSize * gridSize, textureData, 0, nullptr, nullptr);
+    // Step 1: Copy the texture data into the persistent input buffer. The write is non-blocking;
+    // the blocking read in step 3 drains the in-order queue before textureData can be reused.
+    FrameSlot& slot = slots[0];
+    err = clEnqueueWriteBuffer(queue, slot.inputBuffer, CL_FALSE, 0, bufferSize, textureData, 0, nullptr, nullptr);
     checkError(err, "clEnqueueWriteBuffer (input)");
 
-    // Step 3: Create an OpenCL buffer for the IFFT result
-    cl_mem outputClBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(GLfloat) * 2 * gridSize * gridSize, nullptr, &err);
-    checkError(err, "clCreateBuffer (output)");
+    // Step 2: Perform the IFFT using OpenCL FFT
+    enqueueTransform(slot.inputBuffer, slot.outputBuffer, 0, nullptr, nullptr);
 
-    // Step 4: Perform the IFFT using OpenCL FFT
-    err = clfftEnqueueTransform(fftPlan, CLFFT_BACKWARD, 1, &queue, 0, nullptr, nullptr, &inputClBuffer, &outputClBuffer, nullptr);
-    checkError(err, "clfftEnqueueTransform (IFFT)");
+    // Step 3: Read back the result straight into the caller's buffer
+    err = clEnqueueReadBuffer(queue, slot.outputBuffer, CL_TRUE, 0, this->outputSize, outputData, 0, nullptr, nullptr);
+    checkError(err, "clEnqueueReadBuffer (output)");
 
-    // Step 5: Wait for the IFFT to finish
-    err = clFinish(queue);
-    checkError(err, "clFinish");
+    bytesTransferred = bufferSize + this->outputSize;
+}
 
-    // Step 6: Read back the result from the OpenCL buffer into a new buffer
-    GLfloat* ifftData = new GLfloat[gridSize * gridSize * 2]; // Allocate memory to store the IFFT result
-    err = clEnqueueReadBuffer(queue, outputClBuffer, CL_TRUE, 0, sizeof(GLfloat) * 2 * gridSize * gridSize, ifftData, 0, nullptr, nullptr);
-    checkError(err, "clEnqueueReadBuffer (output)");
 
-    // Normalize results if necessary
-//    GLfloat minVal = std::numeric_limits<GLfloat>::max();
-//    GLfloat maxVal = std::numeric_limits<GLfloat>::lowest();
-//
-//    for (size_t i = 0; i < gridSize * gridSize * 2; ++i) {
-//        minVal = std::min(minVal, ifftData[i]);
-//        maxVal = std::max(maxVal, ifftData[i]);
-//    }
 
-//    GLfloat range = maxVal - minVal;
-//    if (range > 0.0f) {
-//        for (size_t i = 0; i < gridSize * gridSize * 2; ++i) {
-//            ifftData[i] = (ifftData[i] - minVal) / range;
-//        }
-//    }
+void OpenCLFFT::setupInterop(GLuint spectrumTexture, GLuint resultTexture) {
+    this->spectrumTexture = spectrumTexture;
+    this->resultTexture = resultTexture;
+
+    transferPath = setupGLSharing() ? TransferPath::GLSharing : TransferPath::MappedHostPtr;
+    std::cout << "OpenCL FFT transfer path: " << getTransferPathName() << std::endl;
+}
+
+bool OpenCLFFT::setupGLSharing() {
+    if (!glSharingContext) {
+        return false;
+    }
+
+    cl_int err;
 
-    // Step 7: Clean up OpenCL buffers
-    err = clReleaseMemObject(inputClBuffer);
-    checkError(err, "clReleaseMemObject (input)");
+    spectrumImage = clCreateFromGLTexture(context, CL_MEM_READ_ONLY, GL_TEXTURE_2D, 0, spectrumTexture, &err);
 
-    err = clReleaseMemObject(outputClBuffer);
-    checkError(err, "clReleaseMemObject (output)");
+    // Each slot's transform writes straight into a GL pixel buffer that is then unpacked into resultTexture on the GPU
+    for (FrameSlot& slot : slots) {
+        if (err != CL_SUCCESS) {
+            break;
+        }
+        glGenBuffers(1, &slot.resultPixelBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.resultPixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, outputSize, nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-    // Step 8: Return the IFFT data to the caller
-    return ifftData;  // Return the IFFT result
+        slot.resultSharedBuffer = clCreateFromGLBuffer(context, CL_MEM_READ_WRITE, slot.resultPixelBuffer, &err);
+    }
+
+    if (err != CL_SUCCESS) {
+        std::cerr << "GL sharing unavailable (" << err << "), falling back to mapped buffers" << std::endl;
+        if (spectrumImage) clReleaseMemObject(spectrumImage);
+        spectrumImage = nullptr;
+        for (FrameSlot& slot : slots) {
+            if (slot.resultSharedBuffer) clReleaseMemObject(slot.resultSharedBuffer);
+            if (slot.resultPixelBuffer) glDeleteBuffers(1, &slot.resultPixelBuffer);
+            slot.resultSharedBuffer = nullptr;
+            slot.resultPixelBuffer = 0;
+        }
+        return false;
+    }
+    return true;
 }
 
+void OpenCLFFT::performIFFTInterop() {
+    submitIFFTInterop();
+    presentIFFTInterop();
+}
 
+void OpenCLFFT::submitIFFTInterop() {
+    FrameSlot& slot = slots[submittedFrames % slots.size()];
+    if (slot.pending) {
+        // The caller skipped a present; drain it so the slot can be reused
+        presentIFFTInterop();
+    }
+
+    if (transferPath == TransferPath::GLSharing) {
+        submitShared(slot);
+    } else {
+        submitMapped(slot);
+    }
+    slot.pending = true;
+    submittedFrames++;
+}
+
+bool OpenCLFFT::presentIFFTInterop() {
+    if (submittedFrames - presentedFrames <= (size_t) latency) {
+        return false;
+    }
+
+    FrameSlot& slot = slots[presentedFrames % slots.size()];
+    if (transferPath == TransferPath::GLSharing) {
+        presentShared(slot);
+    } else {
+        presentMapped(slot);
+    }
+    slot.pending = false;
+    presentedFrames++;
+    return true;
+}
+
+void OpenCLFFT::waitForSpectrumRead() {
+    if (spectrumReleased) {
+        checkError(clWaitForEvents(1, &spectrumReleased), "clWaitForEvents (spectrum)");
+        releaseEvent(spectrumReleased);
+    }
+}
+
+void OpenCLFFT::waitForGLSync(GLsync& sync) {
+    if (!sync) {
+        return;
+    }
+    GLenum status;
+    do {
+        status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+    } while (status == GL_TIMEOUT_EXPIRED);
+    glDeleteSync(sync);
+    sync = nullptr;
+}
+
+void OpenCLFFT::submitShared(FrameSlot& slot) {
+    cl_int err;
+    cl_mem input;
+
+    // Step 1: Wait for GL to finish unpacking this slot's previous result
+    waitForGLSync(slot.unpackFence);
+
+    if (evolveSpectrum) {
+        err = clEnqueueAcquireGLObjects(queue, 1, &slot.resultSharedBuffer, 0, nullptr, nullptr);
+        checkError(err, "clEnqueueAcquireGLObjects");
+
+        input = spectrumBuffer;
+    } else {
+        // The host does not wait for the spectrum pass: with cl_khr_gl_event the acquire waits for its fence on the
+        // device, otherwise the flush submits it and the acquire's implicit GL synchronisation orders the two.
+        // The slot's previous fence was passed by the transform presented before this slot came round again.
+        if (slot.spectrumFence) glDeleteSync(slot.spectrumFence);
+        slot.spectrumFence = nullptr;
+        cl_event spectrumRendered = nullptr;
+        if (createEventFromGLSync) {
+            slot.spectrumFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+            spectrumRendered = createEventFromGLSync(context, (cl_GLsync) slot.spectrumFence, &err);
+            checkError(err, "clCreateEventFromGLsyncKHR");
+        } else {
+            glFlush();
+        }
+
+        cl_mem glObjects[2] = {spectrumImage, slot.resultSharedBuffer};
+        err = clEnqueueAcquireGLObjects(queue, 2, glObjects, spectrumRendered ? 1 : 0,
+                                        spectrumRendered ? &spectrumRendered : nullptr, nullptr);
+        releaseEvent(spectrumRendered);
+        checkError(err, "clEnqueueAcquireGLObjects");
+
+        // Step 2: Copy the RG32F texels into the linear complex buffer clFFT expects (device-side), then hand the
+        // spectrum texture back to GL straight away so the next frame can render into it
+        size_t origin[3] = {0, 0, 0};
+        size_t region[3] = {gridSize, gridSize, 1};
+        err = clEnqueueCopyImageToBuffer(queue, spectrumImage, slot.inputBuffer, origin, region, 0, 0, nullptr, nullptr);
+        checkError(err, "clEnqueueCopyImageToBuffer (spectrum)");
+
+        releaseEvent(spectrumReleased);
+        err = clEnqueueReleaseGLObjects(queue, 1, &spectrumImage, 0, nullptr, &spectrumReleased);
+        checkError(err, "clEnqueueReleaseGLObjects (spectrum)");
+        input = slot.inputBuffer;
+    }
+
+    // Step 3: Transform directly into the shared pixel buffer; present waits on the release event
+    writeParams(slot);
+    enqueueTransform(input, slot.resultSharedBuffer, 0, nullptr, nullptr);
+
+    // Step 4: Reduce the finished heights while the buffer is still acquired
+    if (statsKernel) {
+        enqueueHeightStats(slot, slot.resultSharedBuffer);
+    }
+
+    releaseEvent(slot.done);
+    err = clEnqueueReleaseGLObjects(queue, 1, &slot.resultSharedBuffer, 0, nullptr, &slot.done);
+    checkError(err, "clEnqueueReleaseGLObjects (result)");
+    checkError(clFlush(queue), "clFlush");
+}
+
+void OpenCLFFT::presentShared(FrameSlot& slot) {
+    checkError(clWaitForEvents(1, &slot.done), "clWaitForEvents (result)");
+    releaseEvent(slot.done);
+
+    if (statsKernel) {
+        foldHeightStats(slot);
+    }
+
+    // Unpack the pixel buffer into the result texture without leaving the GPU
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.resultPixelBuffer);
+    uploadResult(nullptr);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    slot.unpackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    bytesTransferred = 0;
+}
+
+void OpenCLFFT::submitMapped(FrameSlot& slot) {
+    cl_int err;
+    cl_mem input;
+    cl_event inputReady = nullptr;
+
+    if (evolveSpectrum) {
+        input = spectrumBuffer;
+    } else {
+        // Step 1: Once this slot's previous transform is done with its input, let GL read the spectrum
+        // directly into the buffer's host-visible storage
+        GLfloat* mapped = (GLfloat*) clEnqueueMapBuffer(transferQueue, slot.inputBuffer, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0,
+                                                        bufferSize, slot.inputFree ? 1 : 0, &slot.inputFree, nullptr, &err);
+        checkError(err, "clEnqueueMapBuffer (input)");
+        glBindTexture(GL_TEXTURE_2D, spectrumTexture);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, mapped);
+
+        err = clEnqueueUnmapMemObject(transferQueue, slot.inputBuffer, mapped, 0, nullptr, &inputReady);
+        checkError(err, "clEnqueueUnmapMemObject (input)");
+        checkError(clFlush(transferQueue), "clFlush (transfer)");
+        input = slot.inputBuffer;
+    }
+
+    // Step 2: Perform the IFFT once the input is unmapped and the last result has been presented
+    cl_event waitEvents[2];
+    cl_uint waitCount = 0;
+    if (inputReady) waitEvents[waitCount++] = inputReady;
+    if (slot.outputFree) waitEvents[waitCount++] = slot.outputFree;
+    writeParams(slot);
+    releaseEvent(slot.inputFree);
+    enqueueTransform(input, slot.outputBuffer, waitCount, waitEvents, &slot.inputFree);
+    releaseEvent(inputReady);
+    releaseEvent(slot.outputFree);
+
+    // The stats kernel reads the result, so the map must also wait for it
+    cl_event* resultDone = &slot.inputFree;
+    if (statsKernel) {
+        enqueueHeightStats(slot, slot.outputBuffer);
+        resultDone = &slot.resultRead;
+    }
+    checkError(clFlush(queue), "clFlush");
+
+    // Step 3: Queue a non-blocking map of the result; present waits on its event
+    releaseEvent(slot.done);
+    slot.mappedOutput = (GLfloat*) clEnqueueMapBuffer(transferQueue, slot.outputBuffer, CL_FALSE, CL_MAP_READ, 0,
+                                                      outputSize, 1, resultDone, &slot.done, &err);
+    checkError(err, "clEnqueueMapBuffer (output)");
+    checkError(clFlush(transferQueue), "clFlush (transfer)");
+}
+
+void OpenCLFFT::presentMapped(FrameSlot& slot) {
+    cl_int err;
+
+    checkError(clWaitForEvents(1, &slot.done), "clWaitForEvents (result)");
+    releaseEvent(slot.done);
+
+    if (statsKernel) {
+        foldHeightStats(slot);
+    }
+
+    uploadResult(slot.mappedOutput);
+
+    // glTexSubImage2D has consumed the client memory, so the buffer can go back to the device right away
+    err = clEnqueueUnmapMemObject(transferQueue, slot.outputBuffer, slot.mappedOutput, 0, nullptr, &slot.outputFree);
+    checkError(err, "clEnqueueUnmapMemObject (output)");
+    checkError(clFlush(transferQueue), "clFlush (transfer)");
+    slot.mappedOutput = nullptr;
+
+    // GL readback and upload always cross the bus; mapping only does on discrete devices
+    size_t glBytes = (evolveSpectrum ? 0 : bufferSize) + outputSize;
+    bytesTransferred = glBytes;
+    if (!hostUnifiedMemory) {
+        bytesTransferred += glBytes;
+    }
+}
+
+void OpenCLFFT::uploadResult(const void* data) {
+    if (resultLayers > 1) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, resultTexture);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, gridSize, gridSize, resultLayers, resultFormat, GL_FLOAT, data);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, resultTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridSize, gridSize, resultFormat, GL_FLOAT, data);
+    }
+}
+
+OpenCLFFT::TransferPath OpenCLFFT::getTransferPath() const {
+    return transferPath;
+}
+
+const char* OpenCLFFT::getTransferPathName() const {
+    switch (transferPath) {
+        case TransferPath::GLSharing:
+            return "GL sharing";
+        case TransferPath::MappedHostPtr:
+            return "mapped host buffers";
+        default:
+            return "host copy";
+    }
+}
+
+size_t OpenCLFFT::getBytesTransferred() const {
+    return bytesTransferred;
+}
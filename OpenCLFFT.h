@@ -1,31 +1,254 @@
 #ifndef OPENCLFFT_H
 #define OPENCLFFT_H
 
+#ifdef __APPLE__
 #include <OpenCL/cl.h>
+#include <OpenCL/cl_gl.h>
+#else
+#include <CL/cl.h>
+#include <CL/cl_gl.h>
+#endif
 #include <clFFT.h>
 #include <GL/glew.h>
-#include <OpenCL/cl_gl.h>
+#include <string>
+#include "OceanSpectrum.h"
+#include <vector>
 
 class OpenCLFFT {
 public:
+    // How performIFFTInterop moves the spectrum and height data between GL and CL
+    enum class TransferPath {
+        HostCopy,       // glGetTexImage -> clEnqueueWriteBuffer -> clEnqueueReadBuffer -> glTexSubImage2D
+        MappedHostPtr,  // CL_MEM_ALLOC_HOST_PTR buffers mapped for GL to read/write in place
+        GLSharing       // cl_khr_gl_sharing: CL reads the GL texture and writes a GL pixel buffer directly
+    };
+
+    // How the spectrum is laid out for the inverse transform
+    enum class SpectrumMode {
+        FullComplex,   // Complex-to-complex transform; the height is re + im of the result
+        HermitianReal, // Hermitian half spectrum -> real heights (CLFFT_HERMITIAN_INTERLEAVED -> CLFFT_REAL)
+        PackedPair,    // Two real fields packed into one complex transform as A + iB; x = A, y = B
+        BatchedFields  // Height, choppy displacement and slopes as one batch of packed pairs, written to a
+                       // GL_TEXTURE_2D_ARRAY: layer 0 = (height, 0), layer 1 = (Dx, Dz), layer 2 = (dh/dx, dh/dz),
+                       // repeated for every cascade
+    };
+
+    // Real fields that can be derived from the height spectrum; must match OCEAN_FIELD_* in oceanCallbacks.cl
+    enum class SpectralField {
+        Height,
+        DisplacementX, // Horizontal (choppy) displacement, -i * kx / |k| * h(k)
+        DisplacementZ,
+        SlopeX,        // dh/dx, i * kx * h(k)
+        SlopeZ
+    };
+
+    // What runs the inverse transform
+    enum class Engine {
+        ClFFT,    // clFFT plan with callbacks: every spectrum mode, but kernels are generated and baked at startup
+        Stockham  // fft_kernel.cl: radix-4 local-memory kernels for power-of-two grids, FullComplex mode only
+    };
+
+    // Height field statistics, after scale/offset. With several cascades the surface is their sum, so min and max
+    // add up the cascades' extremes (a bound that holds at every point), mean adds the means and rms assumes the
+    // cascades are uncorrelated.
+    struct HeightStats {
+        float min;
+        float max;
+        float mean;
+        float rms;
+    };
+
     OpenCLFFT();
+    // Whether the device setup would pick advertises CL/GL sharing, checked without creating a context. The
+    // GLSharing transfer path also needs the context creation and texture views in setupInterop to succeed.
+    static bool deviceSharesGL();
+    // Releases only CL objects; GL objects need the context, so call cleanup before it is destroyed
     ~OpenCLFFT();
+    // Releases everything, including the GL pixel buffers and fences of the sharing path. The GL context that owns
+    // the interop textures must be current.
+    void cleanup();
+
+    // Number of frames the height field may lag behind the spectrum (0, 1 or 2). Each frame of latency adds
+    // one in-flight slot so the transform of frame N+1 overlaps the draw of frame N. Call before setup.
+    void setPipelineLatency(int frames);
+
+    // Call before setup. Setups the Stockham kernels do not cover (other spectrum modes, grid sizes that are not a
+    // power of two or do not fit in local memory) fall back to clFFT.
+    void setEngine(Engine engine);
+    Engine getEngine() const;
+    // Stockham engine: treat spectrum bins whose index on either axis is band or more away from 0 (mod N) as zero and
+    // skip their rows, loads and butterflies (pruned IFFT, see fft_kernel.cl). 0 transforms everything; the clFFT
+    // engine always does.
+    void setBandLimit(size_t band);
+
+    // Evolve h0(k) on the device inside the IFFT (clFFT pre-callback) instead of in updateFourier.frag, so only
+    // the time value crosses the bus per frame. patchSize is the side length L of the patch; omega is rounded down to
+    // a multiple of 2 pi / repeatTime, so every bin repeats after repeatTime seconds. Call before setup.
+    void enableSpectrumEvolution(float patchSize, float repeatTime);
+    // HermitianReal and PackedPair build a Hermitian spectrum from h0(k) in the pre-callback, so they require
+    // enableSpectrumEvolution. pairedField is the second field packed next to the height. Call before setup.
+    void setSpectrumMode(SpectrumMode mode, SpectralField pairedField = SpectralField::DisplacementX);
+    // Horizontal displacement multiplier (lambda) applied by the post-callback
+    void setChoppiness(float choppiness);
+    // BatchedFields only: simulate up to maxCascades patches of the given sizes (largest first) in the same batched
+    // transform. Each keeps a non-overlapping band of wavenumbers. Call before setup.
+    void setCascades(const std::vector<float>& patchSizes);
+    size_t getCascadeCount() const;
+    // Uploads the initial spectrum h0(k) (2 * gridSize * gridSize floats) of a cascade once
+    void uploadInitialSpectrum(const GLfloat* h0, size_t cascade = 0);
+    // Generates a cascade's h0(k) on the device (oceanRandom.cl) instead of uploading it; the random numbers are the
+    // same as computeFourier.frag and OceanSpectrum::generate draw for this seed and cascade
+    void generateInitialSpectrum(size_t cascade, cl_uint seed, const OceanSpectrum::Parameters& parameters);
+    // Simulation time the pre-callback applies to the next submitted transform, in [0, repeatTime)
+    void setTime(float time);
+
+    // Apply height = (re + im) * scale + offset in a clFFT post-callback (replacing rescaleHeight.frag) and reduce
+    // min/max/mean/RMS on the device after every interop transform. Call before setup.
+    void enableHeightPostProcessing(float scale, float offset);
+    // Statistics of the most recently presented height field
+    HeightStats getHeightStats() const;
 
     void setup(size_t gridSize);
     void performFFT();
     void performIFFT();
-    GLfloat* performIFFTFromOpenGLTexture(GLfloat* textureData, size_t gridSize);
+
+    // Host staging area for the spectrum (2 * gridSize * gridSize floats), allocated once in setup
+    GLfloat* getStagingBuffer();
+    // Transforms textureData into outputData; outputSize is in floats and must hold 2 * gridSize * gridSize
+    void performIFFTFromOpenGLTexture(const GLfloat* textureData, GLfloat* outputData, size_t outputSize);
+
+    // Binds the RG32F spectrum and result textures and picks the cheapest transfer path the device supports.
+    // In BatchedFields mode resultTexture must be a GL_TEXTURE_2D_ARRAY with getResultLayers() layers.
+    // Must be called after setup with the GL context that owns the textures current.
+    void setupInterop(GLuint spectrumTexture, GLuint resultTexture);
+    // Submits the current spectrum and presents the result that is due this frame
+    void performIFFTInterop();
+    // Enqueues the IFFT of the current spectrumTexture contents without waiting for it
+    void submitIFFTInterop();
+    // Writes the transform submitted `latency` frames ago into resultTexture; false while the pipeline fills
+    bool presentIFFTInterop();
+    // Blocks until CL has finished copying the last submitted spectrum, so GL may render a new one
+    void waitForSpectrumRead();
+
+    static const size_t fieldLayers = 3; // Result layers per cascade in BatchedFields mode
+    static const size_t maxCascades = 4;
+
+    // Number of result layers (1, or 3 per cascade for BatchedFields)
+    size_t getResultLayers() const;
+
+    TransferPath getTransferPath() const;
+    const char* getTransferPathName() const;
+    // Bytes moved across the host/device boundary by the last transform
+    size_t getBytesTransferred() const;
 private:
+    // Resources for one in-flight frame
+    struct FrameSlot {
+        cl_mem inputBuffer;
+        cl_mem outputBuffer;
+        GLuint resultPixelBuffer;  // GL_PIXEL_UNPACK_BUFFER the transform writes into when sharing
+        cl_mem resultSharedBuffer; // CL view of resultPixelBuffer
+        GLfloat* mappedOutput;     // Host view of outputBuffer between submit and present (mapped path)
+        cl_event inputFree;        // Last transform that read inputBuffer
+        cl_event outputFree;       // Last unmap of outputBuffer after presenting
+        cl_event done;             // Result of this slot is ready to present
+        GLsync unpackFence;        // GL finished unpacking resultPixelBuffer
+        GLsync spectrumFence;      // GL finished rendering the spectrum this slot's acquire waited on
+        cl_float params[4];        // Host copy of OceanParams, alive until the slot is presented
+        cl_event resultRead;       // Stats kernel finished reading the result
+        cl_event statsReady;       // Partials have been read back into statsPartials
+        std::vector<cl_float> statsPartials; // min, max, sum, sum of squares per work-group
+        bool pending;
+    };
+
     cl_context context;
     cl_command_queue queue;
-//    cl_mem inputBuffer;
-//    cl_mem outputBuffer;
+    cl_command_queue transferQueue; // Map/unmap traffic, so it does not serialize behind transforms
+    cl_device_id device;
+    cl_mem tmpBuffer;
     clfftPlanHandle fftPlan;
 
-    void cleanup();
+    // Stockham engine state
+    Engine engine;
+    cl_program fftProgram;
+    cl_kernel rowKernel;
+    cl_kernel columnKernel;
+    cl_mem twiddleBuffer;
+    size_t fftGroupSize;
+    size_t bandLimit;
+
+    size_t gridSize;
+    size_t bufferSize; // Bytes in one complex grid
+    size_t outputSize; // Bytes in one result grid (half of bufferSize for real results)
+    GLenum resultFormat; // GL_RG for complex results, GL_RED for real ones
+    size_t resultLayers; // Batched transforms, one texture layer each
+    std::vector<GLfloat> stagingData;
+
+    // Pipelining state
+    int latency;
+    std::vector<FrameSlot> slots;
+    size_t submittedFrames;
+    size_t presentedFrames;
+    cl_event spectrumReleased; // CL no longer reads spectrumTexture
+
+    // Interop state
+    bool glSharingContext;  // Context was created against the current GL share group
+    bool hostUnifiedMemory; // Mapping a buffer does not copy (CPU and integrated devices)
+    TransferPath transferPath;
+    size_t bytesTransferred;
+    GLuint spectrumTexture;
+    GLuint resultTexture;
+    cl_mem spectrumImage;   // CL view of spectrumTexture
+    // cl_khr_gl_event: turns a GL fence into a CL event, so the acquire waits on the device instead of the host
+    typedef cl_event (CL_API_CALL* CreateEventFromGLSync)(cl_context, cl_GLsync, cl_int*);
+    CreateEventFromGLSync createEventFromGLSync;
+
+    // Device-resident spectrum state
+    bool evolveSpectrum;
+    SpectrumMode spectrumMode;
+    SpectralField pairedField;
+    float choppiness;
+    std::vector<float> cascadeSizes;
+    float patchSize;
+    float repeatTime;
+    float time;
+    cl_mem spectrumBuffer; // h0(k), uploaded once
+    cl_mem paramsBuffer;   // OceanParams read by the callbacks
+    cl_program spectrumProgram; // oceanRandom.cl, built on the first generateInitialSpectrum
+    cl_kernel spectrumKernel;
+
+    // Height post-processing state
+    bool postProcessHeights;
+    float heightScale;
+    float heightOffset;
+    cl_program statsProgram;
+    cl_kernel statsKernel;
+    cl_mem statsBuffer;    // Per-work-group partials
+    size_t statsGroups;
+    size_t statsCascades;  // Height layers reduced, one per cascade
+    HeightStats heightStats;
+
+    static cl_int pickDevice(cl_platform_id& platform, cl_device_id& device);
+    static std::string deviceExtensions(cl_device_id device);
+    void createContext(cl_platform_id platform);
+    std::string buildCallbackSource() const;
+    void setupCallbacks();
+    bool setupStockham();
+    void enqueueTransform(cl_mem input, cl_mem output, cl_uint waitCount, cl_event* waitEvents, cl_event* event);
+    void setupHeightStats();
+    void setupSpectrumGenerator();
+    void writeParams(FrameSlot& slot);
+    void enqueueHeightStats(FrameSlot& slot, cl_mem result);
+    void foldHeightStats(FrameSlot& slot);
+    bool setupGLSharing();
+    void submitShared(FrameSlot& slot);
+    void submitMapped(FrameSlot& slot);
+    void presentShared(FrameSlot& slot);
+    void presentMapped(FrameSlot& slot);
+    void uploadResult(const void* data);
+    void waitForGLSync(GLsync& sync);
+    void releaseEvent(cl_event& event);
+    void releaseCLObjects();
     void checkError(cl_int err, const char* operation);
 };
 
 #endif // OPENCLFFT_H
-
-
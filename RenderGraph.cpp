@@ -0,0 +1,184 @@
+#include "RenderGraph.h"
+#include <chrono>
+#include <iostream>
+
+static const GLuint unknownBinding = 0xFFFFFFFF;
+
+RenderGraph::RenderGraph()
+        : built(false), screenWidth(0), screenHeight(0), boundFramebuffer(unknownBinding),
+          boundProgram(unknownBinding), boundVAO(unknownBinding) {}
+
+size_t RenderGraph::addPass(const Pass& pass) {
+    passes.push_back(pass);
+    states.emplace_back();
+    return passes.size() - 1;
+}
+
+void RenderGraph::build() {
+    for (size_t i = 0; i < passes.size(); ++i) {
+        const Pass& pass = passes[i];
+        PassState& state = states[i];
+
+        // Step 1: One framebuffer per distinct target texture, attached once
+        if (pass.output == Output::Texture) {
+            auto it = framebuffers.find(pass.outputTexture);
+            if (it == framebuffers.end()) {
+                GLuint framebuffer;
+                glGenFramebuffers(1, &framebuffer);
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pass.outputTexture, 0);
+                if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                    std::cerr << "Framebuffer of pass " << pass.name << " is not complete!" << std::endl;
+                }
+                it = framebuffers.emplace(pass.outputTexture, framebuffer).first;
+            }
+            state.framebuffer = it->second;
+        }
+
+        // Step 2: Timer queries, several per pass so results are read frames after they were issued
+        glGenQueries(queryLatency, state.queries);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    invalidateState();
+    built = true;
+}
+
+void RenderGraph::cleanup() {
+    for (auto& entry : framebuffers) {
+        glDeleteFramebuffers(1, &entry.second);
+    }
+    framebuffers.clear();
+    if (built) {
+        for (PassState& state : states) {
+            glDeleteQueries(queryLatency, state.queries);
+        }
+    }
+    built = false;
+}
+
+void RenderGraph::setScreenSize(GLsizei width, GLsizei height) {
+    screenWidth = width;
+    screenHeight = height;
+}
+
+void RenderGraph::execute() {
+    for (size_t i = 0; i < passes.size(); ++i) {
+        if (passes[i].everyFrame) {
+            run(i);
+        }
+    }
+}
+
+void RenderGraph::run(size_t index) {
+    const Pass& pass = passes[index];
+    PassState& state = states[index];
+    if (pass.enabled && !pass.enabled()) {
+        return;
+    }
+
+    collectQueries(state);
+    // Reuse a query only once its result has been collected
+    GLuint query = state.queries[state.nextQuery];
+    bool timed = built && !state.queryPending[state.nextQuery];
+    if (timed) {
+        glBeginQuery(GL_TIME_ELAPSED, query);
+    }
+    auto cpuStart = std::chrono::steady_clock::now();
+
+    // Step 1: Target
+    if (pass.output != Output::None) {
+        GLuint framebuffer = pass.output == Output::Texture ? state.framebuffer : 0;
+        if (framebuffer != boundFramebuffer) {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            boundFramebuffer = framebuffer;
+        }
+        if (pass.output == Output::Texture) {
+            glViewport(0, 0, pass.width, pass.height);
+        } else {
+            glViewport(0, 0, screenWidth, screenHeight);
+        }
+    }
+
+    // Step 2: Program, geometry and inputs
+    if (pass.program) {
+        if (pass.program->getId() != boundProgram) {
+            pass.program->use();
+            boundProgram = pass.program->getId();
+        }
+        if (pass.vao != boundVAO) {
+            glBindVertexArray(pass.vao);
+            boundVAO = pass.vao;
+        }
+    }
+    if (pass.output != Output::None) {
+        for (const TextureInput& input : pass.inputs) {
+            GLuint& bound = boundTextures[{input.unit, input.target}];
+            if (bound != input.texture) {
+                glActiveTexture(GL_TEXTURE0 + input.unit);
+                glBindTexture(input.target, input.texture);
+                bound = input.texture;
+            }
+        }
+    }
+
+    pass.execute();
+
+    if (pass.output == Output::None) {
+        invalidateState(); // Host passes may touch any GL state
+    } else if (!pass.program) {
+        boundProgram = unknownBinding;
+        boundVAO = unknownBinding;
+    }
+
+    auto cpuEnd = std::chrono::steady_clock::now();
+    state.cpuMilliseconds += std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count();
+    state.cpuSamples++;
+    if (timed) {
+        glEndQuery(GL_TIME_ELAPSED);
+        state.queryPending[state.nextQuery] = true;
+        state.nextQuery = (state.nextQuery + 1) % queryLatency;
+    }
+}
+
+void RenderGraph::collectQueries(PassState& state) {
+    for (int i = 0; i < queryLatency; ++i) {
+        if (!state.queryPending[i]) {
+            continue;
+        }
+        GLint available = 0;
+        glGetQueryObjectiv(state.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            continue;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(state.queries[i], GL_QUERY_RESULT, &nanoseconds);
+        state.gpuMilliseconds += nanoseconds / 1.0e6;
+        state.gpuSamples++;
+        state.queryPending[i] = false;
+    }
+}
+
+void RenderGraph::invalidateState() {
+    boundFramebuffer = unknownBinding;
+    boundProgram = unknownBinding;
+    boundVAO = unknownBinding;
+    boundTextures.clear();
+}
+
+void RenderGraph::printTimings() {
+    std::cout << "Pass timings (GPU ms / CPU ms per run):" << std::endl;
+    for (size_t i = 0; i < passes.size(); ++i) {
+        PassState& state = states[i];
+        collectQueries(state);
+        if (state.cpuSamples == 0) {
+            continue;
+        }
+        std::cout << "  " << passes[i].name << ": "
+                  << (state.gpuSamples ? state.gpuMilliseconds / state.gpuSamples : 0.0) << " / "
+                  << state.cpuMilliseconds / state.cpuSamples << " (" << state.cpuSamples << " runs)" << std::endl;
+        state.gpuMilliseconds = 0.0;
+        state.gpuSamples = 0;
+        state.cpuMilliseconds = 0.0;
+        state.cpuSamples = 0;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include "ShaderProgram.h"
+
+// Ordered list of GPU passes that declare what they read and where they render. build() creates one immutable
+// framebuffer per render target up front; running a pass binds its target, program, VAO and input textures only
+// where they differ from what is already bound, and wraps it in a GL_TIME_ELAPSED query (read back frames later,
+// never stalling) plus a CPU timer, for a per-pass cost breakdown.
+class RenderGraph {
+public:
+    enum class Output {
+        Texture, // Renders into outputTexture through its own framebuffer
+        Screen,  // Default framebuffer, sized by setScreenSize
+        None     // Host pass (e.g. the OpenCL transform); inputs and outputTexture are declarations only
+    };
+
+    struct TextureInput {
+        GLuint texture;
+        GLenum target; // GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP, ...
+        GLuint unit;   // Texture unit the pass samples it from
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<TextureInput> inputs;
+        Output output = Output::Screen;
+        GLuint outputTexture = 0;
+        GLsizei width = 0;  // Viewport of a Texture output
+        GLsizei height = 0;
+        // Bound by the graph before execute. Passes without a program bind their own program and VAO, which the
+        // graph then forgets it knows about.
+        const ShaderProgram* program = nullptr;
+        GLuint vao = 0;
+        std::function<void()> execute;
+        std::function<bool()> enabled; // Optional; skipped (untimed) while it returns false
+        bool everyFrame = true;        // false: only runs through run()
+    };
+
+    RenderGraph();
+
+    size_t addPass(const Pass& pass);
+    // Creates the framebuffers and timer queries; needs a current GL context
+    void build();
+    void cleanup();
+
+    void setScreenSize(GLsizei width, GLsizei height);
+    // Runs every enabled everyFrame pass in order
+    void execute();
+    // Runs a single pass, e.g. one-off setup work
+    void run(size_t index);
+
+    // Forget the cached bindings after GL state was changed outside the graph
+    void invalidateState();
+    // Average GPU and CPU milliseconds per pass over the frames since the last call
+    void printTimings();
+private:
+    static const int queryLatency = 3; // Frames a timer query result may take to arrive
+
+    struct PassState {
+        GLuint framebuffer = 0;
+        GLuint queries[queryLatency] = {};
+        bool queryPending[queryLatency] = {};
+        int nextQuery = 0;
+        double gpuMilliseconds = 0.0;
+        int gpuSamples = 0;
+        double cpuMilliseconds = 0.0;
+        int cpuSamples = 0;
+    };
+
+    std::vector<Pass> passes;
+    std::vector<PassState> states;
+    std::map<GLuint, GLuint> framebuffers; // Output texture -> framebuffer
+    bool built;
+    GLsizei screenWidth;
+    GLsizei screenHeight;
+
+    // Bindings the graph knows are current; 0xFFFFFFFF = unknown
+    GLuint boundFramebuffer;
+    GLuint boundProgram;
+    GLuint boundVAO;
+    std::map<std::pair<GLuint, GLenum>, GLuint> boundTextures; // (unit, target) -> texture
+
+    void collectQueries(PassState& state);
+};
+
+#endif // RENDERGRAPH_H
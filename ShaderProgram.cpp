@@ -0,0 +1,338 @@
+#include "ShaderProgram.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <glm/gtc/type_ptr.hpp>
+
+std::string ShaderProgram::cacheDirectory;
+std::string ShaderProgram::driverString;
+
+ShaderProgram::ShaderProgram() : id(0), fromCache(false) {}
+
+void ShaderProgram::setBinaryCacheDirectory(const std::string& directory) {
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) {
+        return;
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats == 0) {
+        return; // Driver cannot export binaries
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Cannot create shader cache " << directory << ": " << error.message() << std::endl;
+        return;
+    }
+    cacheDirectory = directory;
+    // A binary is only valid for the driver that produced it
+    driverString = std::string((const char*) glGetString(GL_VENDOR)) + "|" + (const char*) glGetString(GL_RENDERER) +
+                   "|" + (const char*) glGetString(GL_VERSION);
+}
+
+void ShaderProgram::enableParallelCompile() {
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    } else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+}
+
+void ShaderProgram::begin(const std::vector<Stage>& stages) {
+    destroy();
+    this->stages = stages;
+
+    // Step 1: Read the sources and derive the cache key from them
+    sources.clear();
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    auto mix = [&hash](const std::string& text) {
+        for (unsigned char c : text) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+    };
+    mix(driverString);
+    for (const Stage& stage : stages) {
+        sources.push_back(insertDefines(readSource(stage.path), stage.defines));
+        mix(std::to_string(stage.type));
+        mix(sources.back());
+    }
+    std::stringstream key;
+    key << std::hex << hash;
+    cacheKey = key.str();
+
+    // Step 2: Load the cached binary, or start compiling. Nothing here waits for the driver.
+    id = glCreateProgram();
+    fromCache = loadBinary();
+    if (!fromCache) {
+        compileAndLink();
+    }
+}
+
+void ShaderProgram::begin(const std::string& vertexPath, const std::string& fragmentPath) {
+    begin({{GL_VERTEX_SHADER, vertexPath}, {GL_FRAGMENT_SHADER, fragmentPath}});
+}
+
+bool ShaderProgram::finish() {
+    if (!id) {
+        return false;
+    }
+
+    GLint success;
+    glGetProgramiv(id, GL_LINK_STATUS, &success);
+    if (!success && fromCache) {
+        // Stale binary (e.g. the driver was updated without changing its version string): rebuild it
+        fromCache = false;
+        compileAndLink();
+        glGetProgramiv(id, GL_LINK_STATUS, &success);
+    }
+    if (!success) {
+        reportErrors();
+        destroy();
+        return false;
+    }
+
+    releaseShaders();
+    cacheLocations();
+    if (!fromCache) {
+        saveBinary();
+    }
+    sources.clear();
+    return true;
+}
+
+bool ShaderProgram::load(const std::vector<Stage>& stages) {
+    begin(stages);
+    return finish();
+}
+
+bool ShaderProgram::load(const std::string& vertexPath, const std::string& fragmentPath) {
+    return load({{GL_VERTEX_SHADER, vertexPath}, {GL_FRAGMENT_SHADER, fragmentPath}});
+}
+
+void ShaderProgram::destroy() {
+    releaseShaders();
+    if (id) glDeleteProgram(id);
+    id = 0;
+    locations.clear();
+}
+
+std::string ShaderProgram::readSource(const std::string& path, int depth) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open shader " << path << std::endl;
+        return "";
+    }
+
+    // Expand #include "file" lines; the GLSL compiler has no include support of its own
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    std::stringstream source;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t directive = line.find("#include");
+        size_t open = line.find('"');
+        size_t close = line.rfind('"');
+        if (directive != std::string::npos && directive == line.find_first_not_of(" \t") &&
+            open != std::string::npos && close > open) {
+            if (depth >= 8) {
+                std::cerr << "Shader includes nested too deeply in " << path << std::endl;
+                continue;
+            }
+            source << readSource(directory + line.substr(open + 1, close - open - 1), depth + 1) << '\n';
+        } else {
+            source << line << '\n';
+        }
+    }
+    return source.str();
+}
+
+std::string ShaderProgram::insertDefines(const std::string& source, const std::string& defines) {
+    if (defines.empty()) {
+        return source;
+    }
+    // #version has to stay the first line
+    size_t version = source.find("#version");
+    size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+    if (lineEnd == std::string::npos) {
+        return defines + '\n' + source;
+    }
+    return source.substr(0, lineEnd + 1) + defines + '\n' + source.substr(lineEnd + 1);
+}
+
+void ShaderProgram::compileAndLink() {
+    // Compile status is not queried here: that would wait for each compile in turn
+    releaseShaders();
+    for (size_t i = 0; i < stages.size(); ++i) {
+        GLuint shader = glCreateShader(stages[i].type);
+        const char* src = sources[i].c_str();
+        glShaderSource(shader, 1, &src, nullptr);
+        glCompileShader(shader);
+        glAttachShader(id, shader);
+        shaders.push_back(shader);
+    }
+    if (!cacheDirectory.empty()) {
+        glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(id);
+}
+
+std::string ShaderProgram::cachePath() const {
+    return cacheDirectory + "/" + cacheKey + ".bin";
+}
+
+bool ShaderProgram::loadBinary() {
+    if (cacheDirectory.empty()) {
+        return false;
+    }
+    std::ifstream file(cachePath(), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    // The format word, then the binary up to the end of the file
+    GLenum format;
+    file.read((char*) &format, sizeof(format));
+    if (!file.good()) {
+        return false;
+    }
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) {
+        return false;
+    }
+    glProgramBinary(id, format, binary.data(), (GLsizei) binary.size());
+    return true;
+}
+
+void ShaderProgram::saveBinary() const {
+    if (cacheDirectory.empty()) {
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(id, length, nullptr, &format, binary.data());
+
+    // Write to a temporary name first, so a crash never leaves a truncated binary under the real key
+    std::string path = cachePath();
+    std::ofstream file(path + ".tmp", std::ios::binary);
+    file.write((const char*) &format, sizeof(format));
+    file.write(binary.data(), binary.size());
+    file.close();
+    std::error_code error;
+    std::filesystem::rename(path + ".tmp", path, error);
+    if (!file || error) {
+        std::cerr << "Failed to write shader cache " << path << std::endl;
+    }
+}
+
+void ShaderProgram::reportErrors() const {
+    char infoLog[1024];
+    for (size_t i = 0; i < shaders.size(); ++i) {
+        GLint compiled;
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            glGetShaderInfoLog(shaders[i], sizeof(infoLog), nullptr, infoLog);
+            std::cerr << "Shader compilation failed (" << stages[i].path << "): " << infoLog << std::endl;
+        }
+    }
+    glGetProgramInfoLog(id, sizeof(infoLog), nullptr, infoLog);
+    std::cerr << "Shader program linking failed (" << stages.front().path << "): " << infoLog << std::endl;
+}
+
+void ShaderProgram::releaseShaders() {
+    for (GLuint shader : shaders) {
+        if (id) glDetachShader(id, shader);
+        glDeleteShader(shader);
+    }
+    shaders.clear();
+}
+
+void ShaderProgram::cacheLocations() {
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint arraySize = 0;
+        GLenum type = 0;
+        glGetActiveUniform(id, i, (GLsizei) name.size(), &length, &arraySize, &type, name.data());
+        GLint loc = glGetUniformLocation(id, name.data());
+        if (loc < 0) {
+            continue; // Member of a uniform block
+        }
+
+        // Arrays are reported as "name[0]"; register them under "name" as well
+        std::string uniformName(name.data(), length);
+        locations[uniformName] = loc;
+        size_t bracket = uniformName.find('[');
+        if (bracket != std::string::npos) {
+            locations[uniformName.substr(0, bracket)] = loc;
+        }
+    }
+}
+
+void ShaderProgram::bindUniformBlock(const char* blockName, GLuint binding) const {
+    GLuint index = glGetUniformBlockIndex(id, blockName);
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(id, index, binding);
+    }
+}
+
+void ShaderProgram::use() const {
+    glUseProgram(id);
+}
+
+GLuint ShaderProgram::getId() const {
+    return id;
+}
+
+bool ShaderProgram::isLoaded() const {
+    return id != 0;
+}
+
+GLint ShaderProgram::location(const std::string& name) const {
+    auto it = locations.find(name);
+    return it != locations.end() ? it->second : -1;
+}
+
+void ShaderProgram::set(const std::string& name, int value) const {
+    glUniform1i(location(name), value);
+}
+
+void ShaderProgram::set(const std::string& name, float value) const {
+    glUniform1f(location(name), value);
+}
+
+void ShaderProgram::set(const std::string& name, const glm::vec2& value) const {
+    glUniform2fv(location(name), 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(const std::string& name, const glm::ivec2& value) const {
+    glUniform2iv(location(name), 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(const std::string& name, const glm::vec3& value) const {
+    glUniform3fv(location(name), 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(const std::string& name, const glm::mat4& value) const {
+    glUniformMatrix4fv(location(name), 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(const std::string& name, const float* values, GLsizei count) const {
+    glUniform1fv(location(name), count, values);
+}
+
+void ShaderProgram::set(const std::string& name, const glm::vec2* values, GLsizei count) const {
+    glUniform2fv(location(name), count, glm::value_ptr(values[0]));
+}
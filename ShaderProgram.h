@@ -0,0 +1,87 @@
+#ifndef SHADERPROGRAM_H
+#define SHADERPROGRAM_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// A linked GL program that resolves every active uniform location once at link time, so per-frame code never
+// calls glGetUniformLocation. Shader sources may `#include "file"` (relative to the including file) to share
+// declarations such as the FrameUniforms block.
+//
+// Loading is split in two so startup can overlap it with other work: begin() only issues the compile and link (or
+// the glProgramBinary of a cached program), finish() waits for the result. With GL_KHR_parallel_shader_compile
+// the driver compiles on its own threads in between.
+class ShaderProgram {
+public:
+    struct Stage {
+        GLenum type;       // GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, ...
+        std::string path;
+        std::string defines; // Lines such as "#define N 256", inserted after the #version line
+    };
+
+    ShaderProgram();
+
+    // Linked programs are cached in directory, keyed by the source hash and the GL vendor/renderer/version, so a
+    // warm start skips compilation. Empty (the default) disables the cache. Call once, with a context current.
+    static void setBinaryCacheDirectory(const std::string& directory);
+    // Lets the driver compile on as many threads as it likes, if it supports that
+    static void enableParallelCompile();
+
+    // Starts compiling and linking the stages, or loading the cached binary
+    void begin(const std::vector<Stage>& stages);
+    void begin(const std::string& vertexPath, const std::string& fragmentPath);
+    // Waits for the link, caches the uniform locations and stores new binaries; false (with the log on std::cerr)
+    // on failure
+    bool finish();
+    // begin + finish
+    bool load(const std::vector<Stage>& stages);
+    bool load(const std::string& vertexPath, const std::string& fragmentPath);
+    void destroy();
+
+    // Binds the named std140 block to a uniform buffer binding point; no-op when the program does not use it
+    void bindUniformBlock(const char* blockName, GLuint binding) const;
+
+    void use() const;
+    GLuint getId() const;
+    bool isLoaded() const;
+    // Cached location, -1 for uniforms that are missing or optimised away (glUniform* then ignores the call)
+    GLint location(const std::string& name) const;
+
+    // Set on the program in use
+    void set(const std::string& name, int value) const;
+    void set(const std::string& name, float value) const;
+    void set(const std::string& name, const glm::vec2& value) const;
+    void set(const std::string& name, const glm::ivec2& value) const;
+    void set(const std::string& name, const glm::vec3& value) const;
+    void set(const std::string& name, const glm::mat4& value) const;
+    void set(const std::string& name, const float* values, GLsizei count) const;
+    void set(const std::string& name, const glm::vec2* values, GLsizei count) const;
+private:
+    GLuint id;
+    std::unordered_map<std::string, GLint> locations;
+
+    // State between begin and finish
+    std::vector<Stage> stages;
+    std::vector<std::string> sources; // After #include expansion
+    std::vector<GLuint> shaders;
+    std::string cacheKey;
+    bool fromCache;
+
+    static std::string cacheDirectory;
+    static std::string driverString;
+
+    static std::string readSource(const std::string& path, int depth = 0);
+    static std::string insertDefines(const std::string& source, const std::string& defines);
+    void compileAndLink();
+    bool loadBinary();
+    void saveBinary() const;
+    std::string cachePath() const;
+    void reportErrors() const;
+    void releaseShaders();
+    void cacheLocations();
+};
+
+#endif // SHADERPROGRAM_H
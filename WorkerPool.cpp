@@ -0,0 +1,84 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(size_t workers) : body(nullptr), count(0), chunkSize(1), nextIndex(0), busyWorkers(0),
+                                         generation(0), stopping(false) {
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t worker = 1; worker < workers; ++worker) {
+        threads.emplace_back(&WorkerPool::workerLoop, this, worker);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+size_t WorkerPool::getWorkerCount() const {
+    return threads.size() + 1;
+}
+
+void WorkerPool::parallelFor(size_t count, size_t chunkSize, const Body& body) {
+    if (count == 0) {
+        return;
+    }
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    if (threads.empty() || count <= chunkSize) {
+        body(0, count, 0);
+        return;
+    }
+
+    // Step 1: Publish the job and wake the workers
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->body = &body;
+        this->count = count;
+        this->chunkSize = chunkSize;
+        nextIndex.store(0);
+        busyWorkers = threads.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    // Step 2: Work alongside them, then wait for the stragglers
+    runChunks(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busyWorkers == 0; });
+    this->body = nullptr;
+}
+
+void WorkerPool::workerLoop(size_t worker) {
+    size_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        runChunks(worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0) {
+            finished.notify_one();
+        }
+    }
+}
+
+void WorkerPool::runChunks(size_t worker) {
+    // Chunks are claimed dynamically so a descheduled worker does not hold up the others
+    for (size_t begin = nextIndex.fetch_add(chunkSize); begin < count; begin = nextIndex.fetch_add(chunkSize)) {
+        (*body)(begin, std::min(begin + chunkSize, count), worker);
+    }
+}
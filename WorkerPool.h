@@ -0,0 +1,45 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that split index ranges between them. The threads live as long as the pool, so a parallel
+// loop costs a wake-up rather than thread creation; the calling thread takes part as worker 0.
+class WorkerPool {
+public:
+    // body(begin, end, worker) handles indices [begin, end); worker < getWorkerCount() identifies per-worker scratch
+    typedef std::function<void(size_t, size_t, size_t)> Body;
+
+    // 0 = one worker per hardware thread
+    explicit WorkerPool(size_t workers = 0);
+    ~WorkerPool();
+
+    size_t getWorkerCount() const;
+    // Runs body over [0, count) in chunks of chunkSize indices and returns when all are done
+    void parallelFor(size_t count, size_t chunkSize, const Body& body);
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    // Current job, published under mutex with a new generation
+    const Body* body;
+    size_t count;
+    size_t chunkSize;
+    std::atomic<size_t> nextIndex;
+    size_t busyWorkers;
+    size_t generation;
+    bool stopping;
+
+    void workerLoop(size_t worker);
+    void runChunks(size_t worker);
+};
+
+#endif // WORKERPOOL_H
@@ -0,0 +1,53 @@
+#version 330 core
+
+// Per-bin state of the incremental time evolution (updateFourier.frag with INCREMENTAL_PHASE):
+//   rg = z = exp(i * omega * t), the bin's phase as a unit rotor
+//   ba = exp(i * omega * dt), the rotation of one simulation step
+// Each frame advances z by the whole steps the host's double-precision clock has run through, with complex
+// multiplies only. A rotor is its phase wrapped modulo 2 pi, so precision does not depend on how long the session
+// has been running.
+
+uniform sampler2D phaseTexture; // Previous state
+uniform int steps;              // Simulation steps since the previous frame
+uniform bool reset;             // Start at t = 0 (z = 1) and compute the step rotors
+uniform float stepTime;         // dt
+uniform int N; // grid size
+uniform float L; // size of the water plane
+
+in vec2 texCoords;
+
+out vec4 fragColor;
+
+
+#include "oceanWave.glsl"
+
+vec2 complexMultiply(vec2 a, vec2 b) {
+    return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+void main() {
+    if (reset) {
+        // The wave vector computeFourier.frag generated this texel's h0 for
+        vec2 k = oceanWaveVector(oceanWaveNumber(ivec2(gl_FragCoord.xy), N), L);
+
+        // w * dt is small, so its sine and cosine are accurate
+        float omega = oceanDispersion(k);
+        fragColor = vec4(1.0, 0.0, cos(omega * stepTime), sin(omega * stepTime));
+        return;
+    }
+
+    vec4 state = texelFetch(phaseTexture, ivec2(gl_FragCoord.xy), 0);
+
+    // z * step^steps, squaring the step rotor for each bit of steps
+    vec2 z = state.rg;
+    vec2 rotor = state.ba;
+    for (int remaining = steps; remaining > 0; remaining >>= 1) {
+        if ((remaining & 1) != 0) {
+            z = complexMultiply(z, rotor);
+        }
+        rotor = complexMultiply(rotor, rotor);
+    }
+
+    // Back onto the unit circle, so rounding cannot grow or shrink the waves over millions of steps
+    fragColor = vec4(z * inversesqrt(dot(z, z)), state.ba);
+}
@@ -1,40 +1,205 @@
-// fft_kernel.cl - 2D Inverse FFT (cIFFT)
-__kernel void cifft_kernel(__global float* inputReal, __global float* inputImaginary,
-                            __global float* outputReal, __global float* outputImaginary,
-                            const unsigned int width, const unsigned int height) {
+// fft_kernel.cl - 2D inverse FFT of the ocean spectrum without clFFT
+// Appended to oceanCallbacks.cl by OpenCLFFT, so the spectrum evolution and height store are the very functions the
+// clFFT callbacks use. OpenCLFFT also prepends:
+//   OCEAN_FFT_GROUP_SIZE  work-items per line (each loops over the butterflies of a stage)
+//   OCEAN_FFT_RADIX2      defined when log2(N) is odd: one radix-2 stage ahead of the radix-4 stages
+//   OCEAN_FFT_EVOLVE      the row pass evolves h0(k) to h(k, t) while loading (oceanEvolveSpectrum)
+//   OCEAN_FFT_STORE_HEIGHT the column pass writes (re + im) * scale + offset (oceanStoreHeight)
+// Each work-group transforms one row (oceanIFFTRows) or column (oceanIFFTColumns) in local memory with Stockham
+// autosort stages, so no bit reversal is needed. Each pass scales by 1 / N, matching clFFT's backward transform.
+// twiddles[t] = exp(2 * pi * i * t / N) is filled once by the host in double precision.
+// Input bins with an index of band or more away from 0 (mod N) on either axis are treated as zero (pruned IFFT): the
+// row pass only runs the 2 * band rows that can be nonzero, every line only loads the indices [0, band) and
+// [N - band, N), and the first stages, whose input is still confined to that band, only run the butterflies it reaches.
+// band = N / 2 transforms everything.
 
-    int x = get_global_id(0);
-    int y = get_global_id(1);
+float2 oceanComplexMultiply(float2 a, float2 b) {
+    return (float2)(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+// i * v
+float2 oceanTimesI(float2 v) {
+    return (float2)(-v.y, v.x);
+}
+
+// One Stockham stage of radix R: butterfly j reads src[j + r * N / R], twiddles and transforms them, and writes
+// dst[(j / Ns) * Ns * R + j % Ns + r * Ns]. Ns is the length of the sub-transforms already done.
+void oceanRadix2Stage(__local const float2* src, __local float2* dst, int Ns, __global const float2* twiddles) {
+    for (int j = get_local_id(0); j < OCEAN_N / 2; j += OCEAN_FFT_GROUP_SIZE) {
+        int k = j & (Ns - 1);
+        float2 a = src[j];
+        float2 b = oceanComplexMultiply(src[j + OCEAN_N / 2], twiddles[k * (OCEAN_N / (2 * Ns))]);
+
+        int index = ((j - k) << 1) + k;
+        dst[index] = a + b;
+        dst[index + Ns] = a - b;
+    }
+}
+
+void oceanRadix4Stage(__local const float2* src, __local float2* dst, int Ns, __global const float2* twiddles) {
+    for (int j = get_local_id(0); j < OCEAN_N / 4; j += OCEAN_FFT_GROUP_SIZE) {
+        int k = j & (Ns - 1);
+        int step = k * (OCEAN_N / (4 * Ns));
+        float2 v0 = src[j];
+        float2 v1 = oceanComplexMultiply(src[j + OCEAN_N / 4], twiddles[step]);
+        float2 v2 = oceanComplexMultiply(src[j + OCEAN_N / 2], twiddles[2 * step]);
+        float2 v3 = oceanComplexMultiply(src[j + 3 * OCEAN_N / 4], twiddles[3 * step]);
+
+        // Inverse 4-point DFT: out[m] = sum of v[r] * i^(r * m)
+        float2 sum02 = v0 + v2;
+        float2 diff02 = v0 - v2;
+        float2 sum13 = v1 + v3;
+        float2 diff13 = oceanTimesI(v1 - v3);
+
+        int index = ((j - k) << 2) + k;
+        dst[index] = sum02 + sum13;
+        dst[index + Ns] = diff02 + diff13;
+        dst[index + 2 * Ns] = sum02 - sum13;
+        dst[index + 3 * Ns] = diff02 - diff13;
+    }
+}
+
+// First radix-2 stage with src confined to [0, band) and [N - band, N), 4 * band <= N: butterfly j sees a alone
+// (j < band) or b alone (j >= N / 2 - band), and the output is confined to the band 2 * band
+void oceanPrunedRadix2Stage(__local const float2* src, __local float2* dst, int band) {
+    for (int i = get_local_id(0); i < 2 * band; i += OCEAN_FFT_GROUP_SIZE) {
+        int j = i < band ? i : OCEAN_N / 2 - 2 * band + i;
+        float2 v = i < band ? src[j] : src[j + OCEAN_N / 2];
+        dst[2 * j] = v;
+        dst[2 * j + 1] = i < band ? v : -v;
+    }
+}
 
-    // Perform the inverse FFT on the rows first
-    float realSum = 0.0f;
-    float imaginarySum = 0.0f;
+// Radix-4 stage with src confined to the band, 8 * band <= N and band a multiple of Ns: butterfly j sees v0 alone
+// (j < band), whose twiddle is 1, or v3 alone (j >= N / 4 - band), and the output is confined to the band 4 * band
+void oceanPrunedRadix4Stage(__local const float2* src, __local float2* dst, int Ns, int band,
+                            __global const float2* twiddles) {
+    for (int i = get_local_id(0); i < 2 * band; i += OCEAN_FFT_GROUP_SIZE) {
+        int j = i < band ? i : OCEAN_N / 4 - 2 * band + i;
+        int k = j & (Ns - 1);
+        int index = ((j - k) << 2) + k;
+        if (i < band) {
+            float2 v0 = src[j];
+            dst[index] = v0;
+            dst[index + Ns] = v0;
+            dst[index + 2 * Ns] = v0;
+            dst[index + 3 * Ns] = v0;
+        } else {
+            // out[m] = v3 * i^(3 * m)
+            float2 v3 = oceanComplexMultiply(src[j + 3 * OCEAN_N / 4], twiddles[3 * k * (OCEAN_N / (4 * Ns))]);
+            dst[index] = v3;
+            dst[index + Ns] = -oceanTimesI(v3);
+            dst[index + 2 * Ns] = -v3;
+            dst[index + 3 * Ns] = oceanTimesI(v3);
+        }
+    }
+}
 
-    for (int k = 0; k < width; ++k) {
-        // Complex exponential term e^(-2πikx/N) for the rows
-        float angle = -2.0f * M_PI * x * k / width;
-        float realPart = cos(angle);
-        float imaginaryPart = sin(angle);
+// Transforms the line whose band was loaded into buffer[0 .. N) and returns where the result ended up (buffer or
+// buffer + N)
+__local float2* oceanTransformLine(__local float2* buffer, int band, __global const float2* twiddles) {
+    __local float2* src = buffer;
+    __local float2* dst = buffer + OCEAN_N;
+    __local float2* swap;
+    int Ns = 1;
+
+    // Step 1: Stages whose input is still confined to the band; each widens it by its radix
+#ifdef OCEAN_FFT_RADIX2
+    if (4 * band <= OCEAN_N) {
+        oceanPrunedRadix2Stage(src, dst, band);
+        barrier(CLK_LOCAL_MEM_FENCE);
+        swap = src;
+        src = dst;
+        dst = swap;
+        band *= 2;
+        Ns = 2;
+    }
+#endif
+    for (; 8 * band <= OCEAN_N; Ns *= 4) {
+        oceanPrunedRadix4Stage(src, dst, Ns, band, twiddles);
+        barrier(CLK_LOCAL_MEM_FENCE);
+        swap = src;
+        src = dst;
+        dst = swap;
+        band *= 4;
+    }
 
-        realSum += (inputReal[k + y * width] * realPart - inputImaginary[k + y * width] * imaginaryPart);
-        imaginarySum += (inputImaginary[k + y * width] * realPart + inputReal[k + y * width] * imaginaryPart);
+    // Step 2: Nothing wrote the rest of the line yet
+    for (int i = band + get_local_id(0); i < OCEAN_N - band; i += OCEAN_FFT_GROUP_SIZE) {
+        src[i] = (float2)(0.0f);
     }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-    // Now perform the FFT on the columns
-    float realFinal = 0.0f;
-    float imaginaryFinal = 0.0f;
+    // Step 3: Full stages
+#ifdef OCEAN_FFT_RADIX2
+    if (Ns == 1) {
+        oceanRadix2Stage(src, dst, Ns, twiddles);
+        barrier(CLK_LOCAL_MEM_FENCE);
+        swap = src;
+        src = dst;
+        dst = swap;
+        Ns = 2;
+    }
+#endif
+    for (; Ns < OCEAN_N; Ns *= 4) {
+        oceanRadix4Stage(src, dst, Ns, twiddles);
+        barrier(CLK_LOCAL_MEM_FENCE);
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+    return src;
+}
 
-    for (int k = 0; k < height; ++k) {
-        // Complex exponential term e^(-2πiky/N) for the columns
-        float angle = -2.0f * M_PI * y * k / height;
-        float realPart = cos(angle);
-        float imaginaryPart = sin(angle);
+// One work-group per row y in the band: h(k, t) (or the caller's spectrum) -> row IFFT -> scratch. The rows outside the
+// band are zero and never read by the column pass.
+__kernel __attribute__((reqd_work_group_size(OCEAN_FFT_GROUP_SIZE, 1, 1)))
+void oceanIFFTRows(__global const float2* input, __global float2* scratch, __global const float2* twiddles,
+                   __global const OceanParams* params, int band) {
+    __local float2 buffer[2 * OCEAN_N];
+    int group = get_group_id(0);
+    int y = group < band ? group : OCEAN_N - 2 * band + group;
 
-        realFinal += (realSum * realPart - imaginarySum * imaginaryPart);
-        imaginaryFinal += (imaginarySum * realPart + realSum * imaginaryPart);
+    // Step 1: Load (and evolve) the band of the row
+    for (int i = get_local_id(0); i < 2 * band; i += OCEAN_FFT_GROUP_SIZE) {
+        int x = i < band ? i : OCEAN_N - 2 * band + i;
+#ifdef OCEAN_FFT_EVOLVE
+        buffer[x] = oceanEvolveSpectrum((__global void*) input, y * OCEAN_N + x, (__global void*) params);
+#else
+        buffer[x] = input[y * OCEAN_N + x];
+#endif
     }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-    // Apply scaling factor for inverse FFT
-    outputReal[x + y * width] = realFinal / (width * height);
-    outputImaginary[x + y * width] = imaginaryFinal / (width * height);
+    // Step 2: Transform and store
+    __local float2* result = oceanTransformLine(buffer, band, twiddles);
+    for (int x = get_local_id(0); x < OCEAN_N; x += OCEAN_FFT_GROUP_SIZE) {
+        scratch[y * OCEAN_N + x] = result[x] * (1.0f / OCEAN_N);
+    }
+}
+
+// One work-group per column x: scratch -> column IFFT -> output (complex, or heights)
+__kernel __attribute__((reqd_work_group_size(OCEAN_FFT_GROUP_SIZE, 1, 1)))
+void oceanIFFTColumns(__global const float2* scratch, __global float2* output, __global const float2* twiddles,
+                      __global const OceanParams* params, int band) {
+    __local float2 buffer[2 * OCEAN_N];
+    int x = get_group_id(0);
+
+    // Step 1: Load the band of the column, the rows the row pass wrote
+    for (int i = get_local_id(0); i < 2 * band; i += OCEAN_FFT_GROUP_SIZE) {
+        int y = i < band ? i : OCEAN_N - 2 * band + i;
+        buffer[y] = scratch[y * OCEAN_N + x];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Step 2: Transform and store
+    __local float2* result = oceanTransformLine(buffer, band, twiddles);
+    for (int y = get_local_id(0); y < OCEAN_N; y += OCEAN_FFT_GROUP_SIZE) {
+        float2 value = result[y] * (1.0f / OCEAN_N);
+#ifdef OCEAN_FFT_STORE_HEIGHT
+        oceanStoreHeight((__global void*) output, y * OCEAN_N + x, (__global void*) params, value);
+#else
+        output[y * OCEAN_N + x] = value;
+#endif
+    }
 }
@@ -0,0 +1,19 @@
+// Per-frame constants shared by the water and sky shaders, filled once per frame from main.cpp's FrameUniforms
+// (std140, binding point 0). Pulled in with #include by ShaderProgram.
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 model;
+    mat3 normalMatrix;          // transpose(inverse(view * model)), computed once on the CPU
+    vec4 LightPosition;         // in eye space
+    vec4 LightAmbient;
+    vec4 LightDiffuse;
+    vec4 LightSpecular;
+    vec4 cameraPosition;        // World space, w unused
+    vec4 cascadeScale;          // size / patch size of each cascade
+    vec4 cascadeMinWavelength;  // Shortest wave in each cascade's band
+    float size;                 // size of the plane
+    int gridSize;
+    int cascadeCount;
+    bool useOceanFields;        // Batched IFFT layers in oceanFields are valid
+};
@@ -0,0 +1,49 @@
+// heightStats.cl - min/max/sum/sum of squares of the height field (first channel of the IFFT result)
+// Each work-group reduces a strided slice in local memory and writes one partial; the host folds the partials.
+// The second NDRange dimension is the cascade, whose heights start STATS_CASCADE_STRIDE floats after the previous
+// one's; partials are cascade-major.
+// STATS_GROUP_SIZE (work-group size, power of two), STATS_COUNT (number of heights per cascade), STATS_STRIDE (floats
+// per texel: 2 for complex results, 1 for real ones) and STATS_CASCADE_STRIDE are prepended by OpenCLFFT.
+
+__kernel __attribute__((reqd_work_group_size(STATS_GROUP_SIZE, 1, 1)))
+void heightStats(__global const float* heights, __global float4* partials) {
+    __local float localMin[STATS_GROUP_SIZE];
+    __local float localMax[STATS_GROUP_SIZE];
+    __local float localSum[STATS_GROUP_SIZE];
+    __local float localSumSq[STATS_GROUP_SIZE];
+
+    uint lid = get_local_id(0);
+    heights += get_global_id(1) * STATS_CASCADE_STRIDE;
+
+    float minVal = INFINITY;
+    float maxVal = -INFINITY;
+    float sum = 0.0f;
+    float sumSq = 0.0f;
+    for (uint i = get_global_id(0); i < STATS_COUNT; i += get_global_size(0)) {
+        float h = heights[i * STATS_STRIDE];
+        minVal = fmin(minVal, h);
+        maxVal = fmax(maxVal, h);
+        sum += h;
+        sumSq += h * h;
+    }
+
+    localMin[lid] = minVal;
+    localMax[lid] = maxVal;
+    localSum[lid] = sum;
+    localSumSq[lid] = sumSq;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (uint offset = STATS_GROUP_SIZE / 2; offset > 0; offset >>= 1) {
+        if (lid < offset) {
+            localMin[lid] = fmin(localMin[lid], localMin[lid + offset]);
+            localMax[lid] = fmax(localMax[lid], localMax[lid + offset]);
+            localSum[lid] += localSum[lid + offset];
+            localSumSq[lid] += localSumSq[lid + offset];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0) {
+        partials[get_group_id(1) * get_num_groups(0) + get_group_id(0)] = (float4)(localMin[0], localMax[0], localSum[0], localSumSq[0]);
+    }
+}
@@ -4,18 +4,27 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
 #include <glm/gtc/type_ptr.hpp>
 #include "Camera.h"
 #include "OpenCLFFT.h"
-#include "IFFT.h"
-#include <clFFT.h>
-#include <Accelerate/Accelerate.h>
+#include "FFTBackend.h"
+#include "CDLODQuadtree.h"
+#include "ShaderProgram.h"
+#include "RenderGraph.h"
+#include "GLComputeFFT.h"
+#include "OceanSpectrum.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 
-GLuint waterVAO, waterVBO, waterEBO, waterShader;
-GLuint skyboxVAO, skyboxVBO, skyboxShader;
+GLuint waterVAO; // No attributes, shader.vert generates the grid
+ShaderProgram waterShader;
+ShaderProgram waterTessShader; // waterTess.* + shader.frag, not loaded without GL 4.0
+GLuint skyboxVAO, skyboxVBO;
+ShaderProgram skyboxShader;
 GLuint skyBoxtid;
 //GLuint projectionLoc, viewLoc, modelLoc;
 glm::mat4 projection, view;
@@ -23,21 +32,31 @@ glm::vec3 cameraPos = glm::vec3(0.0f, 13.0f, 2.5f);
 float cameraWidth = 800.0f;
 float cameraHeight = 600.0f;
 Camera camera(cameraWidth, cameraHeight, cameraPos);
-int waterPlaneIndexCount;
 GLuint oceanHeightTexture;
 GLuint fftTexture;
 GLuint ifftTexture;
+GLuint oceanFieldsTexture; // Batched IFFT result, see OpenCLFFT::SpectrumMode::BatchedFields
 GLuint fourierHeightTexture;
+GLuint phaseTextures[2]; // Ping-ponged rotor state of advancePhase.frag
 GLuint quadVAO, quadVBO, quadEBO;
 
-GLuint computeFourierShader;
-GLuint updateFourierShader;
-GLuint rescaleHeightShader;
+ShaderProgram computeFourierShader;
+ShaderProgram updateFourierShader;
+ShaderProgram advancePhaseShader;
+ShaderProgram rescaleHeightShader;
 
-GLuint framebuffer;
+// Every GL pass of a frame, plus the one-off spectrum initialisation
+RenderGraph renderGraph;
+size_t computeFourierPass;
+float spectrumPatchSize; // Parameters of the next computeFourierPass run
+int spectrumCascade;
 
 OpenCLFFT fftProcessor;
-IFFT ifftClass;
+GLComputeFFT computeFFT;
+std::unique_ptr<FFTBackend> fftBackend; // Runs ifft() when the OpenCL interop path is off
+std::vector<GLfloat> spectrumData; // Host copies for fftBackend, sized once at startup
+std::vector<GLfloat> ifftData;
+OpenCLFFT::HeightStats spectrumHeightBound = {}; // Culling bound of the paths without per-frame height statistics
 
 // Light info.
 const GLfloat lightAmbient[] = { 0.1f, 0.2f, 0.3f, 1.0f };
@@ -48,6 +67,84 @@ const GLfloat lightPosition[4] = {0.0f, 100.0f, 0.0f, 1.0f }; // Given in eye sp
 // Grid size
 const int gridSize = 1024; // Number of segments in each direction
 const float size = 100.0f;  // Size of the plane
+// Height = (re + im) * heightScale + heightOffset of the IFFT result, as in rescaleHeight.frag
+const float heightScale = 1000.0f;
+const float heightOffset = 10.0f;
+
+// Run the IFFT through OpenCLFFT's interop path (GL sharing or mapped buffers) instead of host copies. Cleared at
+// startup if the selected FFT backend has no interop path.
+bool useGLInterop = true;
+// Frames the drawn height field lags the spectrum (0, 1 or 2); more latency lets CL and GL overlap more
+const int pipelineLatency = 1;
+// Run the spectrum update, IFFT and rescale as GL compute passes (GLComputeFFT) instead of OpenCL. Chosen anyway when
+// GL 4.3 is available but CL/GL sharing is not, so the OpenCL path would go through host memory every frame.
+bool preferGLComputeFFT = false; // Also set by --fft-backend=gl-compute
+bool useComputeFFT = false; // Decided at startup
+// updateFourier.frag multiplies h0(k) by a per-bin rotor that advancePhase.frag steps forward by phaseStepTime
+// instead of evaluating sin/cos of the float time: constant precision however long the session runs
+const bool incrementalPhase = true;
+const double phaseStepTime = 1.0 / 240.0;
+double phaseClock = 0.0; // Simulated time the rotors have reached, in seconds of glfwGetTime
+int phaseSteps = 0;      // Steps to advance this frame
+float phaseFraction = 0.0f; // Part of a step the frame time is past phaseClock, [0, 1); applied in updateFourier.frag
+int phaseTarget = 1;     // phaseTextures entry this frame writes; 1 so the first frame writes 0
+bool phaseReset = true;  // Initialise the rotors on the next advance
+// Every path rounds omega down to a multiple of 2 pi / spectrumRepeatTime (oceanDispersion in oceanWave.glsl and
+// oceanCallbacks.cl), so the ocean repeats after this many seconds and spectrumTime() wraps the double clock into
+// [0, spectrumRepeatTime): omega * t stays as precise in float however long the session runs
+const double spectrumRepeatTime = 200.0;
+// Prepended to every program that includes oceanWave.glsl
+const std::string oceanWaveDefines = "#define OCEAN_REPEAT_TIME " + std::to_string(spectrumRepeatTime);
+// Upload h0(k) once and evolve it inside the IFFT (clFFT pre-callback) instead of running updateFourier.frag
+const bool evolveSpectrumOnDevice = true;
+// Hermitian spectrum -> real heights halves the transform, buffers and transfers of the full complex IFFT;
+// BatchedFields also produces choppy displacement and slopes in the same launch sequence
+const OpenCLFFT::SpectrumMode spectrumMode = OpenCLFFT::SpectrumMode::BatchedFields;
+const float choppiness = 1.0f;
+// FFT backend without --fft-backend: "auto" benchmarks every available one (see FFTBackend::select); "stockham-cl"
+// skips clFFT's kernel generation and plan bake, but only runs the FullComplex spectrum mode
+const char* const defaultFFTBackend = "clfft";
+// Pruned IFFT: the CPU and Stockham engines treat spectrum bins outside a square band of wavenumbers around k = 0 as
+// zero and skip them. A cutoff in rad/m sets the band directly; without one it is the narrowest band that drops at
+// most fftPruneEnergy of the energy of h0(k). Both 0 transform the full grid. On the OpenCL path only the Stockham
+// engine honours the band; clFFT, the default, always transforms everything.
+const float fftWavenumberCutoff = 0.0f;
+const double fftPruneEnergy = 1e-6;
+// Patch sizes of the cascades in BatchedFields mode, largest first (swells down to ripples); at most 4
+const std::vector<float> cascadePatchSizes = {size * 4.0f, size, size / 4.0f};
+// Initial spectrum h0(k): JONSWAP parameters and the Philox key, shared by computeFourier.frag, oceanRandom.cl and
+// OceanSpectrum. The same seed gives the same ocean on every backend.
+const OceanSpectrum::Parameters spectrumParameters;
+const uint32_t spectrumSeed = 0;
+
+// How the water surface is meshed; M cycles through the modes at runtime. Up to Projected, must match MESH_* in
+// shader.vert; Tessellation uses its own program.
+enum class WaterMeshMode {
+    Grid,  // Fixed (gridSize + 1)^2 world-space grid, generated in shader.vert from gl_VertexID/gl_InstanceID
+    CDLOD, // Distance-dependent quadtree of instanced patches with frustum culling
+    Horizon, // CDLOD over the periodic FFT tile repeated out to horizonDistance, following the camera
+    Projected, // Screen-aligned grid intersected with the sea plane, uniform density in screen space
+    Tessellation, // Coarse patches subdivided by projected edge length and wave steepness (needs GL 4.0)
+    Count
+};
+WaterMeshMode waterMeshMode = WaterMeshMode::CDLOD;
+const char* waterMeshModeNames[] = {"grid", "CDLOD quadtree", "horizon", "projected grid", "tessellation"};
+
+// Covers the same plane as the grid; 6 levels of 32^2-quad patches, finest level out to 8 m
+CDLODQuadtree waterQuadtree(size, 6, 32, 8.0f);
+// Far plane of the horizon mode, and the coarsest range of its quadtree (25 m * 2^7)
+const float horizonDistance = 3200.0f;
+// 64 x 64 tiles, finest nodes 50 m; the centre follows the camera in 400 m steps (getCenterSnap), a whole number of
+// tiles
+CDLODQuadtree horizonQuadtree(size * 64.0f, 8, 32, 25.0f);
+// Tessellation mode: tessPatchCount^2 patches of at most 64^2 quads, so up to 2048^2 over the plane
+const int tessPatchCount = 32;
+const float tessPixelsPerEdge = 8.0f;
+const float tessSteepnessFactor = 2.0f;
+// Projected grid: quads across and down the screen (about 4 px each at 800 x 600) and NDC overscan
+const int projectedGridColumns = 200;
+const int projectedGridRows = 150;
+const float projectedGridMargin = 1.1f;
 
 float quadVertices[] = {
         -1.0f, -1.0f,
@@ -61,161 +158,207 @@ unsigned int quadIndices[] = {
         2, 3, 0
 };
 
-// Function to read shader source from file
-std::string readShaderSource(const std::string& filePath) {
-    std::ifstream file(filePath);
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
-}
-
-// Function to compile shader
-GLuint compileShader(const std::string& source, GLenum shaderType) {
-    GLuint shader = glCreateShader(shaderType);
-    const char* src = source.c_str();
-    glShaderSource(shader, 1, &src, nullptr);
-    glCompileShader(shader);
-
-    // Check for compilation errors
-    int success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        std::cerr << "Shader compilation failed: " << infoLog << std::endl;
+// CPU mirror of the std140 FrameUniforms block in frameUniforms.glsl, uploaded once per frame
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3]; // std140 mat3: three vec4-aligned columns
+    glm::vec4 lightPosition;
+    glm::vec4 lightAmbient;
+    glm::vec4 lightDiffuse;
+    glm::vec4 lightSpecular;
+    glm::vec4 cameraPosition;
+    glm::vec4 cascadeScale;
+    glm::vec4 cascadeMinWavelength;
+    GLfloat size;
+    GLint gridSize;
+    GLint cascadeCount;
+    GLint useOceanFields;
+};
+const GLuint frameUniformsBinding = 0;
+// Linked program binaries from earlier runs, relative to the working directory
+const char* shaderCacheDirectory = "shaderCache";
+GLuint frameUniformBuffer;
+
+// Starts building every program without waiting for the driver, so texture and FFT plan setup overlap compilation.
+// Programs whose sources and driver match an earlier run load from shaderCacheDirectory instead.
+void beginShaders(bool tessellationSupported) {
+    ShaderProgram::setBinaryCacheDirectory(shaderCacheDirectory);
+    ShaderProgram::enableParallelCompile();
+
+    waterShader.begin("../shader.vert", "../shader.frag");
+    computeFourierShader.begin({{GL_VERTEX_SHADER, "../fullScreenQuad.vert"},
+                                {GL_FRAGMENT_SHADER, "../computeFourier.frag", oceanWaveDefines}});
+    updateFourierShader.begin({{GL_VERTEX_SHADER, "../fullScreenQuad.vert"},
+                               {GL_FRAGMENT_SHADER, "../updateFourier.frag",
+                                oceanWaveDefines + (incrementalPhase ? "\n#define INCREMENTAL_PHASE" : "")}});
+    if (incrementalPhase) {
+        advancePhaseShader.begin({{GL_VERTEX_SHADER, "../fullScreenQuad.vert"},
+                                  {GL_FRAGMENT_SHADER, "../advancePhase.frag", oceanWaveDefines}});
+    }
+    rescaleHeightShader.begin("../fullScreenQuad.vert", "../rescaleHeight.frag");
+    skyboxShader.begin("../skyBox.vert", "../skyBox.frag");
+    if (tessellationSupported) {
+        waterTessShader.begin({{GL_VERTEX_SHADER, "../waterTess.vert"},
+                               {GL_TESS_CONTROL_SHADER, "../waterTess.tesc"},
+                               {GL_TESS_EVALUATION_SHADER, "../waterTess.tese"},
+                               {GL_FRAGMENT_SHADER, "../shader.frag"}});
     }
-
-    return shader;
 }
 
-// Function to create shader program
-GLuint createShaderProgram(const std::string& vertexPath, const std::string& fragmentPath) {
-    std::string vertexSource = readShaderSource(vertexPath);
-    std::string fragmentSource = readShaderSource(fragmentPath);
-
-    GLuint vertexShader = compileShader(vertexSource, GL_VERTEX_SHADER);
-    GLuint fragmentShader = compileShader(fragmentSource, GL_FRAGMENT_SHADER);
-
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    // Check for linking errors
-    int success;
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-        std::cerr << "Shader program linking failed: " << infoLog << std::endl;
+// Waits for the programs started by beginShaders, binds the FrameUniforms block and sets the sampler units, which
+// never change
+void finishShaders() {
+    for (ShaderProgram* program : {&waterShader, &computeFourierShader, &updateFourierShader, &advancePhaseShader,
+                                   &rescaleHeightShader, &skyboxShader, &waterTessShader}) {
+        program->finish();
     }
 
-    // Clean up shaders
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return shaderProgram;
+    for (ShaderProgram* program : {&waterShader, &waterTessShader}) {
+        if (!program->isLoaded()) continue;
+        program->bindUniformBlock("FrameUniforms", frameUniformsBinding);
+        program->use();
+        program->set("inputTexture", 0);
+        program->set("envMap", 4);
+        program->set("oceanFields", 5);
+    }
+    skyboxShader.bindUniformBlock("FrameUniforms", frameUniformsBinding);
+    skyboxShader.use();
+    skyboxShader.set("skybox", 4);
+    updateFourierShader.use();
+    updateFourierShader.set("fftTexture", 1);
+    updateFourierShader.set("phaseTexture", 6);
+    if (advancePhaseShader.isLoaded()) {
+        advancePhaseShader.use();
+        advancePhaseShader.set("phaseTexture", 6);
+    }
+    rescaleHeightShader.use();
+    rescaleHeightShader.set("ifftTexture", 2);
+    glUseProgram(0);
+
+    glGenBuffers(1, &frameUniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, frameUniformsBinding, frameUniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-
-
-void generatePlane(float** vertices, unsigned int** indices, int* indexCount) {
-    // Generate vertices
-    *vertices = new float[(gridSize + 1) * (gridSize + 1) * 3]; // 3 for x, y, z
-    for (int z = 0; z <= gridSize; ++z) {
-        for (int x = 0; x <= gridSize; ++x) {
-            (*vertices)[(z * (gridSize + 1) + x) * 3 + 0] = (x / (float)gridSize) * size - size / 2; // x
-            (*vertices)[(z * (gridSize + 1) + x) * 3 + 1] = 0.0f; // y (initially flat)
-            (*vertices)[(z * (gridSize + 1) + x) * 3 + 2] = (z / (float)gridSize) * size - size / 2; // z
-        }
+// Camera, light and ocean constants for every shader, in one upload per frame
+void updateFrameUniforms() {
+    FrameUniforms frame = {};
+    frame.view = view;
+    frame.projection = projection;
+    frame.model = glm::mat4(1.0f); // Identity matrix (no transformation)
+    // Once per frame instead of an inverse() per vertex
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(view * frame.model)));
+    for (int i = 0; i < 3; ++i) {
+        frame.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
     }
-
-    // Generate indices
-    *indexCount = gridSize * gridSize * 6; // Each quad consists of 2 triangles
-    *indices = new unsigned int[*indexCount];
-    int offset = 0;
-    for (int z = 0; z < gridSize; ++z) {
-        for (int x = 0; x < gridSize; ++x) {
-            (*indices)[offset++] = (z * (gridSize + 1)) + x;         // Top left
-            (*indices)[offset++] = ((z + 1) * (gridSize + 1)) + x;   // Bottom left
-            (*indices)[offset++] = (z * (gridSize + 1)) + (x + 1);   // Top right
-
-            (*indices)[offset++] = ((z + 1) * (gridSize + 1)) + x;   // Bottom left
-            (*indices)[offset++] = ((z + 1) * (gridSize + 1)) + (x + 1); // Bottom right
-            (*indices)[offset++] = (z * (gridSize + 1)) + (x + 1);   // Top right
+    frame.lightPosition = glm::make_vec4(lightPosition);
+    frame.lightAmbient = glm::make_vec4(lightAmbient);
+    frame.lightDiffuse = glm::make_vec4(lightDiffuse);
+    frame.lightSpecular = glm::make_vec4(lightSpecular);
+    frame.cameraPosition = glm::vec4(camera.Position, 1.0f);
+
+    size_t cascadeCount = fftProcessor.getCascadeCount();
+    for (size_t c = 0; c < cascadeCount; ++c) {
+        frame.cascadeScale[c] = size / cascadePatchSizes[c];
+        // Shortest wave of the cascade: two texels, or where the next cascade's band starts (see OpenCLFFT)
+        frame.cascadeMinWavelength[c] = 2.0f * cascadePatchSizes[c] / gridSize;
+        if (c + 1 < cascadeCount) {
+            frame.cascadeMinWavelength[c] = std::max(frame.cascadeMinWavelength[c], cascadePatchSizes[c + 1] / 4.0f);
         }
     }
+    frame.size = size;
+    frame.gridSize = gridSize;
+    frame.cascadeCount = (GLint) cascadeCount;
+    frame.useOceanFields = !useComputeFFT && fftProcessor.getResultLayers() > 1;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void setupWater() {
-    // Vertex data for a detailed grid plane
-    float* vertices;
-    unsigned int* indices;
-
-    generatePlane(&vertices, &indices, &waterPlaneIndexCount);
-
+    // No vertex data: shader.vert derives each grid vertex from gl_VertexID and gl_InstanceID, but the core
+    // profile still needs a VAO bound for the draw
     glGenVertexArrays(1, &waterVAO);
-    glGenBuffers(1, &waterVBO);
-    glGenBuffers(1, &waterEBO);
-
-    // Bind VAO
-    glBindVertexArray(waterVAO);
 
-    // Bind and set VBO
-    glBindBuffer(GL_ARRAY_BUFFER, waterVBO);
-    glBufferData(GL_ARRAY_BUFFER, (gridSize + 1) * (gridSize + 1) * 3 * sizeof(float), vertices, GL_STATIC_DRAW);
+    waterQuadtree.setup();
+    horizonQuadtree.setup();
+}
 
-    // Bind and set EBO
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, waterEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, waterPlaneIndexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+// Far clipping plane for the current mesh mode
+float waterFarPlane() {
+    return waterMeshMode == WaterMeshMode::Horizon ? horizonDistance : 100.0f;
+}
 
-    // Configure vertex attributes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+void drawWater() {
+    // Camera, light and ocean constants come from the FrameUniforms block; only mode state is set here
+    const ShaderProgram& program = waterMeshMode == WaterMeshMode::Tessellation ? waterTessShader : waterShader;
+    program.use();
+
+    // Enable blending for water
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);  // Disable writing to the depth buffer
+    program.set("meshMode", (int) waterMeshMode);
+
+    // Bound the displaced surface for culling; before the first statistics arrive, assume the whole plane size.
+    // Only the interop path reduces the heights every frame.
+    OpenCLFFT::HeightStats stats = useGLInterop ? fftProcessor.getHeightStats() : spectrumHeightBound;
+    float span = stats.max > stats.min ? stats.max - stats.min : size;
+
+    if (waterMeshMode == WaterMeshMode::Tessellation) {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        program.set("viewportSize", glm::vec2(viewport[2], viewport[3]));
+        program.set("patchCount", tessPatchCount);
+        program.set("pixelsPerEdge", tessPixelsPerEdge);
+        program.set("steepnessFactor", tessSteepnessFactor);
+        program.set("maxHeight", std::max(std::abs(stats.min), std::abs(stats.max)) + span);
+
+        // Buffer-less like the grid: waterTess.vert derives the patch corners from gl_VertexID
+        glBindVertexArray(waterVAO);
+        glPatchParameteri(GL_PATCH_VERTICES, 4);
+        glDrawArrays(GL_PATCHES, 0, 4 * tessPatchCount * tessPatchCount);
+        glBindVertexArray(0);
+    } else if (waterMeshMode == WaterMeshMode::Projected) {
+        // The Camera's own view and projection are the projector, so the grid follows the benchmark camera path
+        program.set("inverseViewProjection", glm::inverse(projection * view));
+        program.set("projectedGridSize", glm::ivec2(projectedGridColumns, projectedGridRows));
+        program.set("projectedMargin", projectedGridMargin);
+        program.set("projectedHorizon", waterFarPlane());
+
+        // One restart-free triangle strip per row of screen quads, buffer-less like the grid
+        glBindVertexArray(waterVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * (projectedGridColumns + 1), projectedGridRows);
+        glBindVertexArray(0);
+    } else if (waterMeshMode == WaterMeshMode::CDLOD || waterMeshMode == WaterMeshMode::Horizon) {
+        CDLODQuadtree& quadtree = waterMeshMode == WaterMeshMode::CDLOD ? waterQuadtree : horizonQuadtree;
+        if (waterMeshMode == WaterMeshMode::Horizon) {
+            // Follow the camera in steps of the coarsest morph grid, so no vertex swims. That is a whole number of
+            // tiles and the FFT result repeats every `size`, so the surface does not move either.
+            float snap = quadtree.getCenterSnap();
+            quadtree.setCenter(glm::round(glm::vec2(camera.Position.x, camera.Position.z) / snap) * snap);
+        }
 
-    // Unbind VAO
-    glBindVertexArray(0);
+        quadtree.select(projection * view, camera.Position, stats.min - span, stats.max + span);
 
-    delete[] vertices;
-    delete[] indices;
-}
+        const std::vector<glm::vec2>& morphRanges = quadtree.getMorphRanges();
+        program.set("patchResolution", (float) quadtree.getPatchResolution());
+        program.set("morphRanges", morphRanges.data(), (GLsizei) morphRanges.size());
+        quadtree.draw();
+    } else {
+        // One restart-free triangle strip per row of quads, 2 * (gridSize + 1) vertices each
+        glBindVertexArray(waterVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * (gridSize + 1), gridSize);
+        glBindVertexArray(0);
+    }
 
-void drawWater() {
-    glUseProgram(waterShader);
-
-    // Matrices
-    glm::mat4 model = glm::mat4(1.0f);  // Identity matrix (no transformation)
-
-    GLuint modelLoc = glGetUniformLocation(waterShader, "model");
-    GLuint viewLoc = glGetUniformLocation(waterShader, "view");
-    GLuint projectionLoc = glGetUniformLocation(waterShader, "projection");
-    GLuint lightPosLoc = glGetUniformLocation(waterShader, "LightPosition");
-    GLuint lightAmbientLoc = glGetUniformLocation(waterShader, "LightAmbient");
-    GLuint lightDiffuseLoc = glGetUniformLocation(waterShader, "LightDiffuse");
-    GLuint lightSpecularLoc = glGetUniformLocation(waterShader, "LightSpecular");
-    GLuint textureLoc = glGetUniformLocation(waterShader, "inputTexture");
-    GLuint sizeLoc = glGetUniformLocation(waterShader, "size");
-    GLuint gridSizeLoc = glGetUniformLocation(waterShader, "gridSize");
-    GLuint envMapLoc = glGetUniformLocation(waterShader, "envMap");
-
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    glUniform4f(lightPosLoc, lightPosition[0], lightPosition[1], lightPosition[2], lightPosition[3]);
-    glUniform4f(lightAmbientLoc, lightAmbient[0], lightAmbient[1], lightAmbient[2], lightAmbient[3]);
-    glUniform4f(lightDiffuseLoc, lightDiffuse[0], lightDiffuse[1], lightDiffuse[2], lightDiffuse[3]);
-    glUniform4f(lightSpecularLoc, lightSpecular[0], lightSpecular[1], lightSpecular[2], lightSpecular[3]);
-    glUniform1i(textureLoc, 0);
-    glUniform1f(sizeLoc, size);
-    glUniform1i(gridSizeLoc, gridSize);
-    glUniform1i(envMapLoc, 4);
-
-    glBindVertexArray(waterVAO);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skyBoxtid);
-    glDrawElements(GL_TRIANGLES, waterPlaneIndexCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);  // Re-enable depth writing
+    glDisable(GL_BLEND);
 
 //    glBindVertexArray(quadVAO);
 //    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
@@ -223,105 +366,169 @@ void drawWater() {
 
 }
 
-void computeFourier() {
-    glUseProgram(computeFourierShader);
-
-    GLuint alphaLoc = glGetUniformLocation(computeFourierShader, "alpha");
-    GLuint gLoc = glGetUniformLocation(computeFourierShader, "g");
-    GLuint k_pLoc = glGetUniformLocation(computeFourierShader, "k_p");
-    GLuint gammaLoc = glGetUniformLocation(computeFourierShader, "gamma");
-    GLuint NLoc = glGetUniformLocation(computeFourierShader, "N");
-    GLuint LLoc = glGetUniformLocation(computeFourierShader, "L");
+// Renders the initial spectrum h0(k) of a patch of side L into fftTexture; the cascade index decorrelates cascades
+void computeFourier(float L, int cascade) {
+    spectrumPatchSize = L;
+    spectrumCascade = cascade;
+    renderGraph.run(computeFourierPass);
+}
 
-    glUniform1f(alphaLoc, 0.0081);
-    glUniform1f(gLoc, 9.81);
-    glUniform1f(k_pLoc, 0.001);
-    glUniform1f(gammaLoc, 3.3);
-    glUniform1i(NLoc, gridSize);
-    glUniform1f(LLoc, size);
+// Pass bodies: the render graph has already bound the target, program, quad and inputs
 
-    glViewport(0, 0, gridSize, gridSize);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fftTexture, 0);
+void drawSpectrum() {
+    computeFourierShader.set("alpha", spectrumParameters.alpha);
+    computeFourierShader.set("g", spectrumParameters.g);
+    computeFourierShader.set("k_p", spectrumParameters.k_p);
+    computeFourierShader.set("gamma", spectrumParameters.gamma);
+    computeFourierShader.set("N", gridSize);
+    computeFourierShader.set("L", spectrumPatchSize);
+    computeFourierShader.set("seed", (int) spectrumSeed);
+    computeFourierShader.set("cascade", spectrumCascade);
 
-    glBindVertexArray(quadVAO);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+}
 
-    // Unbind the framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+// glfwGetTime wrapped into [0, spectrumRepeatTime) in double, then rounded to float
+float spectrumTime() {
+    return (float) std::fmod(glfwGetTime(), spectrumRepeatTime);
 }
 
 void updateFourier() {
-    glUseProgram(updateFourierShader);
+    if (useGLInterop) {
+        // CL may still be copying the previous spectrum out of fourierHeightTexture
+        fftProcessor.waitForSpectrumRead();
+    }
 
-    GLuint timeLoc = glGetUniformLocation(updateFourierShader, "time");
-    GLuint fftTextureLoc = glGetUniformLocation(updateFourierShader, "fftTexture");
-    GLuint NLoc = glGetUniformLocation(updateFourierShader, "N");
-    GLuint LLoc = glGetUniformLocation(updateFourierShader, "L");
+    updateFourierShader.set("time", spectrumTime());
+    updateFourierShader.set("phaseFraction", phaseFraction);
+    updateFourierShader.set("N", gridSize);
+    updateFourierShader.set("L", size);
 
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
 
-    float currentTime = glfwGetTime();
-    glUniform1f(timeLoc, currentTime);
-    glUniform1i(fftTextureLoc, 1);
-    glUniform1f(NLoc, gridSize);
-    glUniform1f(LLoc, size);
+// Whether updateFourier.frag evolves the spectrum this frame, rather than the compute or OpenCL path
+bool evolveSpectrumOnGL() {
+    return !useComputeFFT && !(useGLInterop && evolveSpectrumOnDevice);
+}
 
-    glViewport(0, 0, gridSize, gridSize);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fourierHeightTexture, 0);
+// Once per frame: whole phaseStepTime steps since the last frame, counted on the double clock, the remainder that
+// updateFourier.frag adds on top so the animation follows the real frame time, and which phaseTextures entry receives
+// the advanced rotors
+void updatePhaseClock() {
+    if (!incrementalPhase || !evolveSpectrumOnGL()) {
+        return;
+    }
+    double now = glfwGetTime();
+    if (phaseReset) {
+        phaseClock = now;
+    }
+    phaseSteps = (int) std::floor((now - phaseClock) / phaseStepTime);
+    phaseClock += phaseSteps * phaseStepTime;
+    phaseFraction = (float) std::min((now - phaseClock) / phaseStepTime, 1.0);
+    phaseTarget = 1 - phaseTarget;
+}
+
+void advancePhase() {
+    advancePhaseShader.set("steps", phaseSteps);
+    advancePhaseShader.set("reset", (int) phaseReset);
+    advancePhaseShader.set("stepTime", (float) phaseStepTime);
+    advancePhaseShader.set("N", gridSize);
+    advancePhaseShader.set("L", size);
+    phaseReset = false;
 
-    glBindVertexArray(quadVAO);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+}
 
-    // Unbind the framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void rescaleHeight() {
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
 
 void ifft() {
+    if (useGLInterop) {
+        // Submit this frame's spectrum and present the one that is pipelineLatency frames old into ifftTexture,
+        // without staging through host arrays. Nothing changes while the pipeline is still filling.
+        if (evolveSpectrumOnDevice) {
+            fftProcessor.setTime(spectrumTime());
+        }
+        // The post-callback writes finished heights straight into oceanHeightTexture, so no rescale pass is needed
+        fftProcessor.submitIFFTInterop();
+        fftProcessor.presentIFFTInterop();
+        return;
+    }
+
+    if (!fftBackend) {
+        return;
+    }
 
-// Step 1: Copy data from OpenGL texture to a structure suited for FFT
-    GLfloat* textureData = new GLfloat[gridSize * gridSize * 2]; // Complex numbers (real + imaginary)
+// Step 1: Copy data from OpenGL texture into the persistent spectrum buffer
+    GLfloat* textureData = spectrumData.data(); // Complex numbers (real + imaginary)
     glBindTexture(GL_TEXTURE_2D, fourierHeightTexture);
     glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, textureData);  // Read the data from OpenGL texture
 
 
-// Step 2: Process IFFT (Inverse FFT)
-    GLfloat* ifftData = fftProcessor.performIFFTFromOpenGLTexture(textureData, gridSize);
-//    std::vector<GLfloat> ifftData = ifftClass.performIFFTFromTextureData(textureData, gridSize);
-
-    size_t totalSize = gridSize * gridSize * 2;
+// Step 2: Process IFFT (Inverse FFT) with the selected backend
+    fftBackend->executeInverse(textureData, ifftData.data());
 
-    GLfloat minVal, maxVal;
-//    vDSP_minv(ifftData.data(), 1, &minVal, totalSize); // Find min
-//    vDSP_maxv(ifftData.data(), 1, &maxVal, totalSize); // Find max
-
-    vDSP_minv(ifftData, 1, &minVal, totalSize); // Find min
-    vDSP_maxv(ifftData, 1, &maxVal, totalSize); // Find max
 
 // Step 3: Copy processed data back to OpenGL texture (ifftTexture)
     glBindTexture(GL_TEXTURE_2D, ifftTexture);
 //    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridSize, gridSize, GL_RG, GL_FLOAT, ifftData.data());  // Update the ifftTexture with processed data
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridSize, gridSize, GL_RG, GL_FLOAT, ifftData);
-// Clean up
-    delete[] textureData;
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridSize, gridSize, GL_RG, GL_FLOAT, ifftData.data());
+}
 
-    glUseProgram(rescaleHeightShader);
+// Picks who runs the IFFT: OpenCLFFT's interop path when the backend has one (configured before its setup),
+// otherwise the backend itself on host copies
+void selectFFTBackend(const std::string& name) {
+    // A named interop backend only configures fftProcessor; planning it on its own would bake a second plan
+    if (useGLInterop && name != "auto") {
+        std::unique_ptr<FFTBackend> backend = FFTBackend::create(name);
+        if (backend && backend->configureInterop(fftProcessor)) {
+            std::cout << "FFT backend: " << name << " (interop)" << std::endl;
+            return;
+        }
+    }
 
-    GLuint ifftTextureLoc = glGetUniformLocation(rescaleHeightShader, "ifftTexture");
-    glUniform1i(ifftTextureLoc, 2);
+    fftBackend = FFTBackend::select(name, gridSize);
+    if (!fftBackend) {
+        std::cerr << "No FFT backend can transform a " << gridSize << "x" << gridSize << " grid" << std::endl;
+    }
+    useGLInterop = useGLInterop && fftBackend && fftBackend->configureInterop(fftProcessor);
+    if (useGLInterop) {
+        fftBackend.reset(); // fftProcessor runs the same engine from here on
+    }
+}
 
-    glViewport(0, 0, gridSize, gridSize);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oceanHeightTexture, 0);
+// Heights h0(k) can ever reach on the host and GL compute paths, which get no per-frame statistics: the inverse
+// transform scales by 1 / N^2, so |re + im| <= sqrt(2) * |h(x)| <= sqrt(2) * sum |h0(k)| / N^2 at any time. rms is the
+// Parseval estimate.
+OpenCLFFT::HeightStats heightBound(const GLfloat* h0) {
+    double amplitude = 0.0;
+    double energy = 0.0;
+    for (size_t i = 0; i < (size_t) gridSize * gridSize; ++i) {
+        double magnitudeSquared = (double) h0[2 * i] * h0[2 * i] + (double) h0[2 * i + 1] * h0[2 * i + 1];
+        amplitude += std::sqrt(magnitudeSquared);
+        energy += magnitudeSquared;
+    }
+    double bins = (double) gridSize * gridSize;
+    float bound = (float) (std::sqrt(2.0) * amplitude / bins * heightScale);
+    float deviation = (float) (std::sqrt(energy) / bins * heightScale);
+    return {heightOffset - bound, heightOffset + bound, heightOffset,
+            std::sqrt(heightOffset * heightOffset + deviation * deviation)};
+}
 
-    glBindVertexArray(quadVAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+// Band of the pruned IFFT for h0(k) of a patch of side L (see fftWavenumberCutoff); gridSize / 2 keeps every bin
+size_t pruneBand(const GLfloat* h0, float L) {
+    if (fftWavenumberCutoff > 0.0f) {
+        // The index of k is k * L / (2 * pi)
+        return std::min<size_t>(gridSize / 2, (size_t) (fftWavenumberCutoff * L / (2.0f * (float) M_PI)) + 1);
+    }
+    return fftPruneEnergy > 0.0 ? FFTBackend::spectrumBand(h0, gridSize, fftPruneEnergy) : gridSize / 2;
+}
 
-    // Unbind the framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+// Spectrum update, IFFT and rescale in two compute dispatches, from fftTexture straight into oceanHeightTexture
+void computeFFTPass() {
+    computeFFT.dispatch(fftTexture, fourierHeightTexture, oceanHeightTexture, spectrumTime());
 }
 
 void setUpEnvMap() {
@@ -462,51 +669,193 @@ void drawSkybox() {
     }
 
 
-    glUseProgram(skyboxShader);
+    // Clear screen and depth buffer
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skyBoxtid);
+    // view and projection come from FrameUniforms; skyBox.vert drops the translation
+    glDisable(GL_DEPTH_TEST);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glEnable(GL_DEPTH_TEST);
+}
+
+// Declares every pass with what it samples and where it renders, in frame order
+void setupRenderGraph() {
+    RenderGraph::Pass spectrum;
+    spectrum.name = "computeFourier";
+    spectrum.output = RenderGraph::Output::Texture;
+    spectrum.outputTexture = fftTexture;
+    spectrum.width = spectrum.height = gridSize;
+    spectrum.program = &computeFourierShader;
+    spectrum.vao = quadVAO;
+    spectrum.execute = drawSpectrum;
+    spectrum.everyFrame = false; // Once per cascade at startup, through computeFourier
+    computeFourierPass = renderGraph.addPass(spectrum);
+
+    RenderGraph::Pass skybox;
+    skybox.name = "skybox";
+    skybox.inputs = {{skyBoxtid, GL_TEXTURE_CUBE_MAP, 4}};
+    skybox.program = &skyboxShader;
+    skybox.vao = skyboxVAO;
+    skybox.execute = drawSkybox;
+    renderGraph.addPass(skybox);
+
+    RenderGraph::Pass evolve;
+    evolve.name = "updateFourier";
+    evolve.inputs = {{fftTexture, GL_TEXTURE_2D, 1}};
+    evolve.output = RenderGraph::Output::Texture;
+    evolve.outputTexture = fourierHeightTexture;
+    evolve.width = evolve.height = gridSize;
+    evolve.program = &updateFourierShader;
+    evolve.vao = quadVAO;
+    evolve.execute = updateFourier;
+    if (incrementalPhase) {
+        // The rotors ping-pong between phaseTextures: per parity, advance them into one entry and evolve with it
+        for (int parity = 0; parity < 2; ++parity) {
+            RenderGraph::Pass advance;
+            advance.name = parity ? "advancePhase (odd)" : "advancePhase (even)";
+            advance.inputs = {{phaseTextures[1 - parity], GL_TEXTURE_2D, 6}};
+            advance.output = RenderGraph::Output::Texture;
+            advance.outputTexture = phaseTextures[parity];
+            advance.width = advance.height = gridSize;
+            advance.program = &advancePhaseShader;
+            advance.vao = quadVAO;
+            advance.execute = advancePhase;
+            advance.enabled = [parity] { return evolveSpectrumOnGL() && phaseTarget == parity; };
+            renderGraph.addPass(advance);
+
+            RenderGraph::Pass evolvePhase = evolve;
+            evolvePhase.inputs.push_back({phaseTextures[parity], GL_TEXTURE_2D, 6});
+            evolvePhase.enabled = advance.enabled;
+            renderGraph.addPass(evolvePhase);
+        }
+    } else {
+        evolve.enabled = evolveSpectrumOnGL;
+        renderGraph.addPass(evolve);
+    }
 
-    GLuint viewLoc = glGetUniformLocation(skyboxShader, "view");
-    GLuint projectionLoc = glGetUniformLocation(skyboxShader, "projection");
-    GLuint skyBoxLoc = glGetUniformLocation(skyboxShader, "skybox");
-    glUniform1i(skyBoxLoc, 4);
+    RenderGraph::Pass transform;
+    transform.name = "ifft";
+    transform.inputs = {{fourierHeightTexture, GL_TEXTURE_2D, 3}};
+    transform.output = RenderGraph::Output::None; // OpenCL writes oceanHeightTexture/oceanFieldsTexture or ifftTexture
+    transform.execute = ifft;
+    transform.enabled = [] { return !useComputeFFT; };
+    renderGraph.addPass(transform);
+
+    RenderGraph::Pass computeTransform;
+    computeTransform.name = "computeFFT";
+    computeTransform.output = RenderGraph::Output::None; // Writes fourierHeightTexture/oceanHeightTexture as images
+    computeTransform.execute = computeFFTPass;
+    computeTransform.enabled = [] { return useComputeFFT; };
+    renderGraph.addPass(computeTransform);
+
+    RenderGraph::Pass rescale;
+    rescale.name = "rescaleHeight";
+    rescale.inputs = {{ifftTexture, GL_TEXTURE_2D, 2}};
+    rescale.output = RenderGraph::Output::Texture;
+    rescale.outputTexture = oceanHeightTexture;
+    rescale.width = rescale.height = gridSize;
+    rescale.program = &rescaleHeightShader;
+    rescale.vao = quadVAO;
+    rescale.execute = rescaleHeight;
+    rescale.enabled = [] { return !useGLInterop && !useComputeFFT; }; // The interop post-callback writes finished heights
+    renderGraph.addPass(rescale);
+
+    RenderGraph::Pass water;
+    water.name = "water";
+    water.inputs = {{oceanHeightTexture, GL_TEXTURE_2D, 0},
+                    {oceanFieldsTexture, GL_TEXTURE_2D_ARRAY, 5},
+                    {skyBoxtid, GL_TEXTURE_CUBE_MAP, 4}};
+    water.execute = drawWater; // Picks its program and geometry per mesh mode
+    renderGraph.addPass(water);
+
+    renderGraph.build();
+}
 
-    // Remove translation
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(glm::mat3(view))));
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
-    glBindVertexArray(skyboxVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+// Prints the per-pass GPU/CPU cost on each press of T
+void handleTimingKey(GLFWwindow* window) {
+    static bool wasPressed = false;
+    bool pressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (pressed && !wasPressed) {
+        renderGraph.printTimings();
+    }
+    wasPressed = pressed;
 }
 
+// Cycles waterMeshMode on each press of M
+void handleMeshModeKey(GLFWwindow* window) {
+    static bool wasPressed = false;
+    bool pressed = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+    if (pressed && !wasPressed) {
+        waterMeshMode = (WaterMeshMode) (((int) waterMeshMode + 1) % (int) WaterMeshMode::Count);
+        if (waterMeshMode == WaterMeshMode::Tessellation && !waterTessShader.isLoaded()) {
+            waterMeshMode = WaterMeshMode::Grid;
+        }
+        std::cout << "Water mesh: " << waterMeshModeNames[(int) waterMeshMode] << std::endl;
+    }
+    wasPressed = pressed;
+}
 
 void cleanup() {
     // Clean up resources
     glDeleteVertexArrays(1, &waterVAO);
-    glDeleteBuffers(1, &waterVBO);
-    glDeleteBuffers(1, &waterEBO);
-    glDeleteProgram(waterShader);
-//    glDeleteProgram(skyboxShader);
+    waterShader.destroy();
+    waterTessShader.destroy();
+    computeFourierShader.destroy();
+    updateFourierShader.destroy();
+    advancePhaseShader.destroy();
+    glDeleteTextures(2, phaseTextures);
+    rescaleHeightShader.destroy();
+    skyboxShader.destroy();
+    glDeleteBuffers(1, &frameUniformBuffer);
+    renderGraph.cleanup();
+    computeFFT.cleanup();
+    waterQuadtree.cleanup();
+    horizonQuadtree.cleanup();
+    // OpenCLFFT tears clFFT down with its last plan. fftProcessor's destructor would run after glfwTerminate, too
+    // late for its interop GL objects.
+    fftProcessor.cleanup();
+    fftBackend.reset();
 }
 
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Command line: --fft-backend=<auto|clfft|stockham-cl|cpu|vdsp|gl-compute>
+    std::string fftBackendName = defaultFFTBackend;
+    bool namedBackend = false;
+    const std::string backendOption = "--fft-backend=";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, backendOption.size(), backendOption) == 0) {
+            fftBackendName = arg.substr(backendOption.size());
+            namedBackend = true;
+        } else {
+            std::cerr << "Unknown option " << arg << "; usage: OceanFFT [--fft-backend=auto|clfft|stockham-cl|cpu|vdsp|gl-compute]" << std::endl;
+        }
+    }
+
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
         return -1;
     }
 
-    // OpenGL version and core profile
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // OpenGL version and core profile: 4.3 for the compute FFT, 4.1 for the tessellation mesh mode (the newest macOS
+    // offers), else 3.3
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);  // Required for macOS
 
     // Create a window and OpenGL context
-    GLFWwindow* window = glfwCreateWindow(800, 600, "3D Plane with Water Movement", nullptr, nullptr);
+    const int contextVersions[][2] = {{4, 3}, {4, 1}, {3, 3}};
+    GLFWwindow* window = nullptr;
+    for (const auto& version : contextVersions) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        window = glfwCreateWindow(800, 600, "3D Plane with Water Movement", nullptr, nullptr);
+        if (window) {
+            break;
+        }
+    }
     if (!window) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -524,12 +873,13 @@ int main() {
     std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 
     // Load and compile shaders
-    waterShader = createShaderProgram("../shader.vert", "../shader.frag");
-//    waterShader = createShaderProgram("../fullScreenQuad.vert", "../temp.frag"); // texture
-    computeFourierShader = createShaderProgram("../fullScreenQuad.vert", "../computeFourier.frag");
-    updateFourierShader = createShaderProgram("../fullScreenQuad.vert", "../updateFourier.frag");
-    rescaleHeightShader = createShaderProgram("../fullScreenQuad.vert", "../rescaleHeight.frag");
-    skyboxShader = createShaderProgram("../skyBox.vert", "../skyBox.frag");
+    if (!GLEW_VERSION_4_0) {
+        std::cout << "No GL 4.0: tessellation mesh mode disabled" << std::endl;
+        if (waterMeshMode == WaterMeshMode::Tessellation) {
+            waterMeshMode = WaterMeshMode::Grid;
+        }
+    }
+    beginShaders(GLEW_VERSION_4_0);
 
 
     // Create quadVAO, quadVBO, quadEBO
@@ -572,6 +922,14 @@ int main() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+    glActiveTexture(GL_TEXTURE5);
+    glGenTextures(1, &oceanFieldsTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, oceanFieldsTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG32F, gridSize, gridSize, OpenCLFFT::fieldLayers * cascadePatchSizes.size(), 0,
+                 GL_RG, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
     glActiveTexture(GL_TEXTURE3);
     glGenTextures(1, &fourierHeightTexture);
     glBindTexture(GL_TEXTURE_2D, fourierHeightTexture);
@@ -579,71 +937,141 @@ int main() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // Create framebuffer
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fftTexture, 0);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Framebuffer is not complete!" << std::endl;
-    } else {
-        std::cout << "Framebuffer complete!" << std::endl;
+    // Rotor state of the incremental evolution: rg = exp(i * omega * t), ba = exp(i * omega * dt), read per texel
+    glGenTextures(2, phaseTextures);
+    for (GLuint texture : phaseTextures) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, gridSize, gridSize, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
     setUpEnvMap();
     setupSkybox();
 
-    setupWater(); // Create vertices for the water height plane
-    computeFourier();
+    setupWater(); // Create the water mesh state
 
-    fftProcessor.setup(gridSize);
+    // gl-compute is not a host backend: GLComputeFFT replaces the whole OpenCL path below
+    bool explicitBackend = namedBackend && fftBackendName != "auto";
+    if (fftBackendName == "gl-compute") {
+        preferGLComputeFFT = true;
+        fftBackendName = defaultFFTBackend;
+    }
 
+    // Keep the whole frame on GL where that beats the OpenCL path, i.e. wherever CL cannot share the GL textures.
+    // Decided before any OpenCL setup, so the path not taken bakes no plan. The compute pass only produces heights,
+    // so the automatic choice keeps OpenCL while its spectrum mode adds cascades, choppiness and slopes; an
+    // explicitly named host backend is kept too.
+    bool openCLFields = useGLInterop && evolveSpectrumOnDevice &&
+                        spectrumMode == OpenCLFFT::SpectrumMode::BatchedFields;
+    bool sharedTextures = useGLInterop && OpenCLFFT::deviceSharesGL();
+    if (GLComputeFFT::isSupported() && (preferGLComputeFFT || (!sharedTextures && !openCLFields && !explicitBackend))) {
+        computeFFT.setHeightScale(heightScale, heightOffset);
+        useComputeFFT = computeFFT.setup(gridSize, size, (float) spectrumRepeatTime);
+        if (useComputeFFT) {
+            std::cout << "IFFT: GL compute shaders" << std::endl;
+            if (openCLFields) {
+                std::cerr << "The GL compute IFFT only produces heights: cascades, choppy displacement and spectral "
+                             "normals are off" << std::endl;
+            }
+            useGLInterop = false;
+        }
+    }
 
+    if (!useComputeFFT) {
+        selectFFTBackend(fftBackendName);
+    }
+    fftProcessor.setPipelineLatency(useGLInterop ? pipelineLatency : 0);
+    if (useGLInterop && evolveSpectrumOnDevice) {
+        fftProcessor.enableSpectrumEvolution(size, (float) spectrumRepeatTime);
+        // The Stockham kernels only run the full complex spectrum
+        fftProcessor.setSpectrumMode(fftProcessor.getEngine() == OpenCLFFT::Engine::Stockham ?
+                                     OpenCLFFT::SpectrumMode::FullComplex : spectrumMode);
+        fftProcessor.setChoppiness(choppiness);
+        if (spectrumMode == OpenCLFFT::SpectrumMode::BatchedFields) {
+            fftProcessor.setCascades(cascadePatchSizes);
+        }
+    }
+    if (useGLInterop) {
+        fftProcessor.enableHeightPostProcessing(heightScale, heightOffset);
+        fftProcessor.setup(gridSize);
+    }
 
+    // Compilation has been overlapping the texture and plan setup above; the spectrum pass needs the programs now
+    finishShaders();
+    setupRenderGraph();
+    computeFourier(size, 0);
+    if (useGLInterop) {
+        GLuint resultTexture = fftProcessor.getResultLayers() > 1 ? oceanFieldsTexture : oceanHeightTexture;
+        fftProcessor.setupInterop(fourierHeightTexture, resultTexture);
+        if (evolveSpectrumOnDevice) {
+            // h0(k) of every cascade is generated on the device, so nothing crosses the bus but the time value.
+            // Only the Stockham engine prunes; for it, the energy-based band needs the spectrum on the host too: the
+            // counter-based RNG draws the same numbers there, while the device kernel runs.
+            bool prune = fftProcessor.getEngine() == OpenCLFFT::Engine::Stockham &&
+                         (fftWavenumberCutoff > 0.0f || fftPruneEnergy > 0.0);
+            if (!prune && (fftWavenumberCutoff > 0.0f || fftPruneEnergy > 0.0)) {
+                std::cout << "Pruned IFFT inactive: clFFT transforms the full grid" << std::endl;
+            }
+            GLfloat* h0 = fftProcessor.getStagingBuffer();
+            bool hostSpectrum = prune && fftWavenumberCutoff <= 0.0f;
+            size_t band = 0;
+            for (size_t c = 0; c < fftProcessor.getCascadeCount(); ++c) {
+                float patchSize = fftProcessor.getCascadeCount() > 1 ? cascadePatchSizes[c] : size;
+                fftProcessor.generateInitialSpectrum(c, spectrumSeed, spectrumParameters);
+                if (hostSpectrum) {
+                    OceanSpectrum::generate(h0, gridSize, patchSize, spectrumSeed, (uint32_t) c, spectrumParameters);
+                }
+                if (prune) {
+                    band = std::max(band, pruneBand(h0, patchSize));
+                }
+            }
+            if (prune) {
+                fftProcessor.setBandLimit(band);
+            }
+        }
+    } else {
+        spectrumData.assign(gridSize * gridSize * 2, 0.0f);
+        ifftData.assign(gridSize * gridSize * 2, 0.0f);
+        glBindTexture(GL_TEXTURE_2D, fftTexture);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, spectrumData.data());
+        spectrumHeightBound = heightBound(spectrumData.data());
+        if (fftBackend) {
+            // The evolved spectrum keeps the magnitudes of h0(k), so its band holds for every frame
+            fftBackend->setBandLimit(pruneBand(spectrumData.data(), size));
+        }
+    }
 
-    while (!glfwWindowShouldClose(window)) {
-        // Clear screen and depth buffer
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // The spectrum upload above bound textures behind the graph's back
+    renderGraph.invalidateState();
 
+    while (!glfwWindowShouldClose(window)) {
         camera.Inputs(window);
+        handleMeshModeKey(window);
+        handleTimingKey(window);
         view = camera.getViewMatrix();
-        projection = camera.getProjMatrix(70.0f, 0.1f, 100.0f);
-
-        glDisable(GL_DEPTH_TEST);
-        drawSkybox();
-        glEnable(GL_DEPTH_TEST);
-
-
-        updateFourier();
-        ifft();
+        projection = camera.getProjMatrix(70.0f, 0.1f, waterFarPlane());
+        updateFrameUniforms();
 
         int width, height;
         glfwGetFramebufferSize(window, &width, &height);
-        glViewport(0, 0, width, height);
-
-
-        // 2️⃣ Enable blending for water
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glDepthMask(GL_FALSE);  // Disable writing to the depth buffer
-
-        drawWater();
-
-        glDepthMask(GL_TRUE);  // Re-enable depth writing
-        glDisable(GL_BLEND);
+        renderGraph.setScreenSize(width, height);
+        updatePhaseClock();
+        renderGraph.execute(); // skybox, updateFourier, ifft, rescaleHeight, water
 
 
         // Swap front and back buffers
         glfwSwapBuffers(window);
+        static bool firstFrame = true;
+        if (firstFrame) {
+            std::cout << "Time to first frame: " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+            firstFrame = false;
+        }
 
         // Poll for and process events
         glfwPollEvents();
     }
 
-    clfftTeardown();
-
     cleanup();
     glfwTerminate();
 
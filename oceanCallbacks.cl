@@ -0,0 +1,216 @@
+// oceanCallbacks.cl - clFFT callbacks for the ocean IFFT
+// Injected into the clFFT-generated kernels, so everything here is prefixed to avoid clashing with them.
+// OCEAN_N (grid size), OCEAN_L (patch size), OCEAN_G (gravity), OCEAN_REPEAT_TIME and, for packed pairs, OCEAN_PAIR_FIRST and
+// OCEAN_PAIR_SECOND (OCEAN_FIELD_* values) are prepended by OpenCLFFT.
+// OCEAN_BATCHED_FIELDS selects the batched callbacks, which also take OCEAN_CASCADES and the per-cascade
+// initializers OCEAN_CASCADE_L, OCEAN_CASCADE_K_MIN and OCEAN_CASCADE_K_MAX.
+// The same source is registered for the pre- and post-callback, and clFFT pastes both into a kernel that uses
+// both, hence the include guard.
+#ifndef OCEAN_CALLBACKS_CL
+#define OCEAN_CALLBACKS_CL
+
+typedef struct {
+    float time; // Wrapped into [0, OCEAN_REPEAT_TIME)
+    float heightScale;
+    float heightOffset;
+    float choppiness;
+} OceanParams;
+
+// Fields derivable from the height spectrum; must match OpenCLFFT::SpectralField
+#define OCEAN_FIELD_HEIGHT 0
+#define OCEAN_FIELD_DISPLACEMENT_X 1
+#define OCEAN_FIELD_DISPLACEMENT_Z 2
+#define OCEAN_FIELD_SLOPE_X 3
+#define OCEAN_FIELD_SLOPE_Z 4
+#define OCEAN_FIELD_NONE 5
+
+// Wave vector of grid index (x, y), same FFT ordering as computeFourier.frag: 0, +ve, -ve
+float2 oceanWaveVector(int x, int y, float patchSize) {
+    int k_x = (x < OCEAN_N / 2) ? x : x - OCEAN_N;
+    int k_y = (y < OCEAN_N / 2) ? y : y - OCEAN_N;
+    return (2.0f * M_PI_F / patchSize) * (float2)((float) k_x, (float) k_y);
+}
+
+// Dispersion relation of deep water, omega = sqrt(|k| * g), rounded down to a multiple of 2 pi / OCEAN_REPEAT_TIME
+// like oceanDispersion in oceanWave.glsl, so that params->time can be wrapped into [0, OCEAN_REPEAT_TIME)
+float oceanDispersion(float2 k) {
+    float omega0 = 2.0f * M_PI_F / OCEAN_REPEAT_TIME;
+    return floor(sqrt(length(k) * OCEAN_G) / omega0) * omega0;
+}
+
+// (a + ib) * (cos(wt) + isin(wt)) = [a*cos(wt) - b*sin(wt)] + i[a*sin(wt) + b*cos(wt)]
+float2 oceanRotate(float2 h, float cosTerm, float sinTerm) {
+    return (float2)(h.x * cosTerm - h.y * sinTerm, h.x * sinTerm + h.y * cosTerm);
+}
+
+// h(k, t) = h0(k) * exp(i * omega * t) + conj(h0(-k)) * exp(-i * omega * t)
+// Hermitian by construction (h(-k, t) = conj(h(k, t))), so its inverse transform is real
+float2 oceanHermitianHeight(__global const float2* h0, int x, int y, float time, float patchSize) {
+    float2 k = oceanWaveVector(x, y, patchSize);
+
+    float omega = oceanDispersion(k);
+    float cosTerm;
+    float sinTerm = sincos(omega * time, &cosTerm);
+
+    float2 hk = h0[y * OCEAN_N + x];
+    float2 hMinusK = h0[((OCEAN_N - y) % OCEAN_N) * OCEAN_N + (OCEAN_N - x) % OCEAN_N];
+
+    return oceanRotate(hk, cosTerm, sinTerm) + oceanRotate((float2)(hMinusK.x, -hMinusK.y), cosTerm, -sinTerm);
+}
+
+// Spectrum of a field derived from the height spectrum h at grid index (x, y), wave vector k. The derived fields
+// are odd in k, and index N/2 (k = -N/2) is its own mirror, so they are not Hermitian on that row and column; they
+// are zeroed there, or their imaginary part would leak into the partner channel of a packed pair.
+float2 oceanFieldSpectrum(int field, int x, int y, float2 k, float2 h) {
+    if (field != OCEAN_FIELD_HEIGHT && (x == OCEAN_N / 2 || y == OCEAN_N / 2)) {
+        return (float2)(0.0f);
+    }
+    float2 iH = (float2)(-h.y, h.x);
+    float kLength = length(k);
+    switch (field) {
+        case OCEAN_FIELD_DISPLACEMENT_X:
+            return kLength > 0.0f ? -iH * (k.x / kLength) : (float2)(0.0f);
+        case OCEAN_FIELD_DISPLACEMENT_Z:
+            return kLength > 0.0f ? -iH * (k.y / kLength) : (float2)(0.0f);
+        case OCEAN_FIELD_SLOPE_X:
+            return iH * k.x;
+        case OCEAN_FIELD_SLOPE_Z:
+            return iH * k.y;
+        case OCEAN_FIELD_NONE:
+            return (float2)(0.0f);
+        default:
+            return h;
+    }
+}
+
+// Spatial value of a field after the inverse transform; only heights get the offset and only displacements
+// the choppiness
+float oceanScaleField(int field, float value, __global const OceanParams* params) {
+    switch (field) {
+        case OCEAN_FIELD_HEIGHT:
+            return value * params->heightScale + params->heightOffset;
+        case OCEAN_FIELD_DISPLACEMENT_X:
+        case OCEAN_FIELD_DISPLACEMENT_Z:
+            return value * params->heightScale * params->choppiness;
+        default:
+            return value * params->heightScale;
+    }
+}
+
+// A + iB for two fields sharing the height spectrum h
+float2 oceanPackPair(int first, int second, int x, int y, float2 k, float2 h) {
+    float2 a = oceanFieldSpectrum(first, x, y, k, h);
+    float2 b = oceanFieldSpectrum(second, x, y, k, h);
+    return (float2)(a.x - b.y, a.y + b.x);
+}
+
+// Pre-callback: evolves h0(k) to h(k, t) = h0(k) * exp(i * omega * t) while clFFT loads its input
+float2 oceanEvolveSpectrum(__global void* input, uint inoffset, __global void* userdata) {
+    __global const OceanParams* params = (__global const OceanParams*) userdata;
+    float2 h0 = ((__global const float2*) input)[inoffset];
+
+    float2 k = oceanWaveVector(inoffset % OCEAN_N, inoffset / OCEAN_N, OCEAN_L);
+
+    float omega = oceanDispersion(k);
+    float cosTerm;
+    float sinTerm = sincos(omega * params->time, &cosTerm);
+
+    return oceanRotate(h0, cosTerm, sinTerm);
+}
+
+// Pre-callback for the complex-to-real plan. The plan reads the non-redundant half (x <= N/2) of the full h0
+// buffer with a row pitch of N, so inoffset still addresses h0 directly.
+float2 oceanEvolveHermitian(__global void* input, uint inoffset, __global void* userdata) {
+    __global const OceanParams* params = (__global const OceanParams*) userdata;
+    return oceanHermitianHeight((__global const float2*) input, inoffset % OCEAN_N, inoffset / OCEAN_N, params->time, OCEAN_L);
+}
+
+#ifdef OCEAN_PAIR_FIRST
+// Pre-callback: packs two real fields A and B into one complex transform as A(k) + i * B(k). Both spectra are
+// Hermitian, so the real part of the result is A and the imaginary part is B.
+float2 oceanEvolvePair(__global void* input, uint inoffset, __global void* userdata) {
+    __global const OceanParams* params = (__global const OceanParams*) userdata;
+    int x = inoffset % OCEAN_N;
+    int y = inoffset / OCEAN_N;
+
+    float2 h = oceanHermitianHeight((__global const float2*) input, x, y, params->time, OCEAN_L);
+    return oceanPackPair(OCEAN_PAIR_FIRST, OCEAN_PAIR_SECOND, x, y, oceanWaveVector(x, y, OCEAN_L), h);
+}
+
+// Post-callback: scales both unpacked fields, so x holds the first and y the second
+void oceanStorePair(__global void* output, uint outoffset, __global void* userdata, float2 fftoutput) {
+    __global const OceanParams* params = (__global const OceanParams*) userdata;
+    ((__global float2*) output)[outoffset] = (float2)(oceanScaleField(OCEAN_PAIR_FIRST, fftoutput.x, params),
+                                                      oceanScaleField(OCEAN_PAIR_SECOND, fftoutput.y, params));
+}
+#endif
+
+#ifdef OCEAN_BATCHED_FIELDS
+// Field pairs of the batched transform, one per layer of each cascade's group in the result texture array:
+// layer 0 = (height, -), layer 1 = (Dx, Dz), layer 2 = (dh/dx, dh/dz)
+#define OCEAN_FIELD_LAYERS 3
+__constant int oceanBatchFields[OCEAN_FIELD_LAYERS][2] = {
+    {OCEAN_FIELD_HEIGHT, OCEAN_FIELD_NONE},
+    {OCEAN_FIELD_DISPLACEMENT_X, OCEAN_FIELD_DISPLACEMENT_Z},
+    {OCEAN_FIELD_SLOPE_X, OCEAN_FIELD_SLOPE_Z}
+};
+
+// Patch size and the |k| band [min, max) each cascade contributes, so no wavelength is counted twice
+__constant float oceanCascadeL[OCEAN_CASCADES] = OCEAN_CASCADE_L;
+__constant float oceanCascadeKMin[OCEAN_CASCADES] = OCEAN_CASCADE_K_MIN;
+__constant float oceanCascadeKMax[OCEAN_CASCADES] = OCEAN_CASCADE_K_MAX;
+
+// Pre-callback for the batched plan. Batches are cascade-major; every batch of a cascade reads h0 from the first
+// plane of its group, the layer within the group only picks which pair of fields to pack.
+float2 oceanEvolveBatch(__global void* input, uint inoffset, __global void* userdata) {
+    __global const OceanParams* params = (__global const OceanParams*) userdata;
+    uint layer = inoffset / (OCEAN_N * OCEAN_N);
+    uint cascade = layer / OCEAN_FIELD_LAYERS;
+    uint field = layer % OCEAN_FIELD_LAYERS;
+    uint texel = inoffset % (OCEAN_N * OCEAN_N);
+    int x = texel % OCEAN_N;
+    int y = texel / OCEAN_N;
+
+    float patchSize = oceanCascadeL[cascade];
+    float2 k = oceanWaveVector(x, y, patchSize);
+    float kLength = length(k);
+    if (kLength < oceanCascadeKMin[cascade] || kLength >= oceanCascadeKMax[cascade]) {
+        return (float2)(0.0f);
+    }
+
+    __global const float2* h0 = (__global const float2*) input + cascade * OCEAN_FIELD_LAYERS * OCEAN_N * OCEAN_N;
+    float2 h = oceanHermitianHeight(h0, x, y, params->time, patchSize);
+    return oceanPackPair(oceanBatchFields[field][0], oceanBatchFields[field][1], x, y, k, h);
+}
+
+// Post-callback for the batched plan: scales both fields of the layer. Cascade heights are summed in
+// shader.vert, so only the first cascade carries the height offset.
+void oceanStoreBatch(__global void* output, uint outoffset, __global void* userdata, float2 fftoutput) {
+    __global const OceanParams* params = (__global const OceanParams*) userdata;
+    uint layer = outoffset / (OCEAN_N * OCEAN_N);
+    uint field = layer % OCEAN_FIELD_LAYERS;
+
+    float2 value = (float2)(oceanScaleField(oceanBatchFields[field][0], fftoutput.x, params),
+                            oceanScaleField(oceanBatchFields[field][1], fftoutput.y, params));
+    if (layer >= OCEAN_FIELD_LAYERS && field == 0) {
+        value.x -= params->heightOffset;
+    }
+    ((__global float2*) output)[outoffset] = value;
+}
+#endif
+
+// Post-callback: applies the height scale/offset that rescaleHeight.frag used to, so the transform writes
+// finished heights (x channel) straight into the result
+void oceanStoreHeight(__global void* output, uint outoffset, __global void* userdata, float2 fftoutput) {
+    __global const OceanParams* params = (__global const OceanParams*) userdata;
+    float height = (fftoutput.x + fftoutput.y) * params->heightScale + params->heightOffset;
+    ((__global float2*) output)[outoffset] = (float2)(height, 0.0f);
+}
+
+// Post-callback for the complex-to-real plan: the result is already the real height
+void oceanStoreRealHeight(__global void* output, uint outoffset, __global void* userdata, float fftoutput) {
+    __global const OceanParams* params = (__global const OceanParams*) userdata;
+    ((__global float*) output)[outoffset] = fftoutput * params->heightScale + params->heightOffset;
+}
+
+#endif // OCEAN_CALLBACKS_CL
@@ -0,0 +1,64 @@
+// oceanRandom.cl - initial spectrum h0(k) generated on the device, the same as computeFourier.frag and OceanSpectrum.cpp
+// Philox-4x32-10 keyed by (seed, cascade) with the wave number (kx, ky) as the counter; the random bits must match
+// oceanRandom.glsl and OceanSpectrum.cpp bit for bit. OCEAN_N (grid size) is prepended by OpenCLFFT.
+
+// Philox-4x32 round multipliers and Weyl key increments
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+uint4 oceanPhilox(uint4 counter, uint2 key) {
+    for (int round = 0; round < 10; ++round) {
+        uint hi0 = mul_hi(PHILOX_M0, counter.x);
+        uint lo0 = PHILOX_M0 * counter.x;
+        uint hi1 = mul_hi(PHILOX_M1, counter.z);
+        uint lo1 = PHILOX_M1 * counter.z;
+        counter = (uint4)(hi1 ^ counter.y ^ key.x, lo1, hi0 ^ counter.w ^ key.y, lo0);
+        key += (uint2)(PHILOX_W0, PHILOX_W1);
+    }
+    return counter;
+}
+
+// (0, 1] from the top 24 bits, exact in float
+float oceanUniform(uint bits) {
+    return (float) ((bits >> 8) + 1u) * (1.0f / 16777216.0f);
+}
+
+// Two independent standard normal values for wave number (kx, ky), by Box-Muller; u1 is never 0
+float2 oceanGaussianPair(uint seed, uint cascade, int kx, int ky) {
+    uint4 bits = oceanPhilox((uint4)((uint) kx, (uint) ky, 0u, 0u), (uint2)(seed, cascade));
+    float radius = sqrt(-2.0f * log(oceanUniform(bits.x)));
+    float theta = 2.0f * M_PI_F * oceanUniform(bits.y);
+    return radius * (float2)(cos(theta), sin(theta));
+}
+
+// One work-item per bin, written in FFT order like uploadInitialSpectrum expects, from bin `offset` of h0 on
+__kernel void oceanInitialSpectrum(__global float2* h0, uint offset, float patchSize, uint seed, uint cascade,
+                                   float alpha, float g, float k_p, float gamma) {
+    h0 += offset;
+
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    if (x >= OCEAN_N || y >= OCEAN_N) {
+        return;
+    }
+
+    int k_x = (x < OCEAN_N / 2) ? x : x - OCEAN_N; // 0, +ve, -ve
+    int k_y = (y < OCEAN_N / 2) ? y : y - OCEAN_N;
+
+    float2 k = (2.0f * 3.14159265359f / patchSize) * (float2)((float) k_x, (float) k_y);
+    float k_mag = length(k);
+    if (k_mag == 0.0f) {
+        h0[y * OCEAN_N + x] = (float2)(0.0f, 0.0f);
+        return;
+    }
+
+    // JONSWAP spectrum
+    float sigma = (k_mag <= k_p) ? 0.07f : 0.09f;
+    float term1 = alpha * g * g / pow(k_mag, 5.0f);
+    float term2 = exp(-1.25f * pow(k_p / k_mag, 4.0f));
+    float term3 = pow(gamma, exp(-0.5f * pow((k_mag / k_p - 1.0f) / sigma, 2.0f)));
+
+    h0[y * OCEAN_N + x] = oceanGaussianPair(seed, cascade, k_x, k_y) * sqrt(term1 * term2 * term3 / 2.0f);
+}
@@ -0,0 +1,44 @@
+// oceanRandom.glsl - Philox-4x32-10 counter-based RNG and the Gaussians of the initial spectrum
+// Must match OceanSpectrum.cpp and oceanRandom.cl bit for bit: a bin's random numbers are a pure function of
+// (seed, cascade, kx, ky), so any backend can regenerate any tile.
+
+// Philox-4x32 round multipliers and Weyl key increments
+const uint philoxM0 = 0xD2511F53u;
+const uint philoxM1 = 0xCD9E8D57u;
+const uint philoxW0 = 0x9E3779B9u;
+const uint philoxW1 = 0xBB67AE85u;
+
+// (high, low) words of a * b; GLSL 3.30 has no umulExtended, so from 16-bit halves
+uvec2 oceanMulHiLo(uint a, uint b) {
+    uint aLo = a & 0xFFFFu;
+    uint aHi = a >> 16;
+    uint bLo = b & 0xFFFFu;
+    uint bHi = b >> 16;
+    uint mid1 = aHi * bLo;
+    uint mid2 = aLo * bHi;
+    uint carry = ((aLo * bLo) >> 16) + (mid1 & 0xFFFFu) + (mid2 & 0xFFFFu);
+    return uvec2(aHi * bHi + (mid1 >> 16) + (mid2 >> 16) + (carry >> 16), a * b);
+}
+
+uvec4 oceanPhilox(uvec4 counter, uvec2 key) {
+    for (int round = 0; round < 10; ++round) {
+        uvec2 product0 = oceanMulHiLo(philoxM0, counter.x);
+        uvec2 product1 = oceanMulHiLo(philoxM1, counter.z);
+        counter = uvec4(product1.x ^ counter.y ^ key.x, product1.y, product0.x ^ counter.w ^ key.y, product0.y);
+        key += uvec2(philoxW0, philoxW1);
+    }
+    return counter;
+}
+
+// (0, 1] from the top 24 bits, exact in float
+float oceanUniform(uint bits) {
+    return float((bits >> 8) + 1u) * (1.0 / 16777216.0);
+}
+
+// Two independent standard normal values for wave number (kx, ky), by Box-Muller; u1 is never 0
+vec2 oceanGaussianPair(uint seed, uint cascade, int kx, int ky) {
+    uvec4 bits = oceanPhilox(uvec4(uint(kx), uint(ky), 0u, 0u), uvec2(seed, cascade));
+    float radius = sqrt(-2.0 * log(oceanUniform(bits.x)));
+    float theta = 2.0 * 3.14159265358979323846 * oceanUniform(bits.y);
+    return radius * vec2(cos(theta), sin(theta));
+}
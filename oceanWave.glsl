@@ -0,0 +1,22 @@
+// Wave vector of a spectrum texel, shared by computeFourier.frag, advancePhase.frag, updateFourier.frag and
+// fftStockham.comp, so every pass evolves a bin with the omega of its own wave number. Same FFT ordering as
+// oceanWaveVector in oceanCallbacks.cl and OceanSpectrum.cpp: index x is k_x = x, or x - N from N / 2 on.
+// Pulled in with #include by ShaderProgram; the including program must define OCEAN_REPEAT_TIME.
+
+// Integer wave number (k_x, k_y) of grid index gridPos (0, +ve, -ve along each axis); also the bin's Philox counter
+ivec2 oceanWaveNumber(ivec2 gridPos, int N) {
+    return ivec2(gridPos.x < N / 2 ? gridPos.x : gridPos.x - N, gridPos.y < N / 2 ? gridPos.y : gridPos.y - N);
+}
+
+// k in rad/m for a patch of side L
+vec2 oceanWaveVector(ivec2 waveNumber, float L) {
+    return (2.0 * 3.14159265359 / L) * vec2(waveNumber);
+}
+
+// Dispersion relation of deep water, omega = sqrt(|k| * g), rounded down to a multiple of 2 pi / OCEAN_REPEAT_TIME
+// (prepended by the host) like oceanDispersion in oceanCallbacks.cl. Every bin then repeats after OCEAN_REPEAT_TIME
+// seconds, so the time can be wrapped into [0, OCEAN_REPEAT_TIME) and omega * t stays bounded.
+float oceanDispersion(vec2 k) {
+    float omega0 = 2.0 * 3.14159265359 / OCEAN_REPEAT_TIME;
+    return floor(sqrt(length(k) * 9.81) / omega0) * omega0;
+}
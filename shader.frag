@@ -1,20 +1,15 @@
 #version 330 core
 
+#include "frameUniforms.glsl"
+
 in vec3 ecNormal;
 in vec3 ecPosition;
 in vec2 texCoords;
 in float waveHeight;
+in vec4 cascadeWeights;
 
 // Light info
-uniform vec4 LightPosition; // in eye space
-uniform vec4 LightAmbient;
-uniform vec4 LightDiffuse;
-uniform vec4 LightSpecular;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform int gridSize;
-uniform sampler2D inputTexture;
+uniform sampler2DArray oceanFields; // Batched IFFT: layer 3 * c + 2 = (dh/dx, dh/dz) of cascade c
 
 uniform samplerCube envMap;
 
@@ -41,25 +36,20 @@ const float n = 100.0;                        // Sharp reflections
 //const float n = 50.0;
 
 
-vec3 computeSurfaceNormal() {
-    ivec2 texel = ivec2(floor(texCoords * float(gridSize - 1)));
-
-    float delta_x = 1.0 / gridSize;
-
-    // Get the height values at the current texel and its neighbors (using central difference)
-    float hL = texelFetch(inputTexture, texel - ivec2(1, 0), 0).x; // Left neighbor
-    float hR = texelFetch(inputTexture, texel + ivec2(1, 0), 0).x; // Right neighbor
-    float hD = texelFetch(inputTexture, texel - ivec2(0, 1), 0).x; // Down neighbor
-    float hU = texelFetch(inputTexture, texel + ivec2(0, 1), 0).x; // Up neighbor
-
-    // Compute the partial derivatives using central difference
-    float dHdx = (hR - hL) / (2.0 * delta_x); // Gradient in the x direction
-    float dHdz = (hU - hD) / (2.0 * delta_x); // Gradient in the z direction
-
-    // Construct the normal vector (negate the gradient and set z to 1)
-    vec3 normal = normalize(vec3(-dHdx, 1.0, -dHdz));
-
-    return normal; //world-space normal
+// Slopes from the batched IFFT give the exact surface normal with one fetch per pixel and cascade. The textures
+// have no mipmaps, so a cascade fades out once a pixel covers more than one of its texels (distant water).
+vec3 surfaceNormal() {
+    if (useOceanFields) {
+        vec2 slope = vec2(0.0);
+        for (int c = 0; c < cascadeCount; ++c) {
+            vec2 uv = texCoords * cascadeScale[c];
+            vec2 texelsPerPixel = fwidth(uv) * float(gridSize);
+            float footprint = 1.0 - smoothstep(1.0, 2.0, max(texelsPerPixel.x, texelsPerPixel.y));
+            slope += cascadeWeights[c] * footprint * texture(oceanFields, vec3(uv, 3 * c + 2)).xy;
+        }
+        return normalize(normalMatrix * vec3(-slope.x, 1.0, -slope.y));
+    }
+    return normalize(ecNormal);
 }
 
 
@@ -76,7 +66,7 @@ void main() {
     lightVec = normalize(LightPosition.xyz - ecPosition);
 
     // Normalize normal vector
-    vec3 N = normalize(ecNormal);
+    vec3 N = surfaceNormal();
 
     // Compute Phong Lighting
     vec3 reflectVec = reflect(-lightVec, N);
@@ -1,22 +1,44 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
+#include "frameUniforms.glsl"
+
+layout (location = 1) in vec2 aPatch; // CDLOD patch vertex in [0, 1]^2
+layout (location = 2) in vec4 aNode;  // CDLOD node (per instance): min corner x/z, size, level
+
+// Must match WaterMeshMode in main.cpp
+const int MESH_GRID = 0;
+const int MESH_CDLOD = 1;
+const int MESH_HORIZON = 2;
+const int MESH_PROJECTED = 3;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform int gridSize;
-uniform float size; // size of the plane
 uniform sampler2D inputTexture;
+uniform sampler2DArray oceanFields; // Batched IFFT, per cascade: (height, 0), (Dx, Dz), slopes
 uniform float minVal;
 uniform float maxVal;
+uniform int meshMode;
+uniform float patchResolution; // Quads per CDLOD patch side
+uniform vec2 morphRanges[8];   // CDLOD (morph start, morph end) distance per level
+uniform mat4 inverseViewProjection; // Projected grid: screen -> world
+uniform ivec2 projectedGridSize;    // Projected grid: quads across and down the screen
+uniform float projectedMargin;      // Projected grid: NDC overscan so displaced water still covers the edges
+uniform float projectedHorizon;     // Projected grid: distance where rays at or above the horizon end
 
 out vec2 texCoords;
 out vec3 ecNormal;
 out vec3 ecPosition;
 out float waveHeight;
+out vec4 cascadeWeights; // How much of each cascade the vertex density can resolve
 
 vec3 computeSurfaceNormal() {
+    // Analytic slopes from the batched IFFT: a single fetch
+    if (useOceanFields) {
+        vec2 slope = vec2(0.0);
+        for (int c = 0; c < cascadeCount; ++c) {
+            slope += cascadeWeights[c] * texture(oceanFields, vec3(texCoords * cascadeScale[c], 3 * c + 2)).xy;
+        }
+        return normalize(vec3(-slope.x, 1.0, -slope.y));
+    }
+
     ivec2 texel = ivec2(floor(texCoords * float(gridSize - 1)));
 
     float delta_x = 1.0 / gridSize;
@@ -38,12 +60,90 @@ vec3 computeSurfaceNormal() {
 }
 
 
+// Grid: drawn as gridSize instanced triangle strips, one per row of quads. Even strip vertices lie on the row's
+// top edge and odd ones on its bottom edge, so the position follows from the IDs alone.
+vec3 gridPosition() {
+    vec2 gridPos = vec2(gl_VertexID >> 1, gl_InstanceID + (gl_VertexID & 1));
+    vec2 worldXZ = gridPos / float(gridSize) * size - size / 2;
+    return vec3(worldXZ.x, 0.0, worldXZ.y);
+}
+
+
+// Projected grid: the same strips as the grid, but over the screen. Each vertex's view ray is intersected with the
+// sea plane y = 0, so the vertex density is uniform in screen space and nothing lands off-screen.
+vec3 projectedPosition() {
+    vec2 gridPos = vec2(gl_VertexID >> 1, gl_InstanceID + (gl_VertexID & 1));
+    vec2 ndc = (gridPos / vec2(projectedGridSize) * 2.0 - 1.0) * projectedMargin;
+
+    vec4 nearPoint = inverseViewProjection * vec4(ndc, -1.0, 1.0);
+    vec4 farPoint = inverseViewProjection * vec4(ndc, 1.0, 1.0);
+    vec3 origin = nearPoint.xyz / nearPoint.w;
+    vec3 direction = farPoint.xyz / farPoint.w - origin;
+
+    float t = -origin.y / direction.y;
+    if (direction.y * origin.y >= 0.0 || t * length(direction) > projectedHorizon) {
+        // Ray misses the plane or hits it beyond the horizon: clamp to the horizon along its heading
+        vec2 heading = normalize(direction.xz + 1e-6);
+        return vec3(origin.x + heading.x * projectedHorizon, 0.0, origin.z + heading.y * projectedHorizon);
+    }
+    return vec3(origin.x + direction.x * t, 0.0, origin.z + direction.z * t);
+}
+
+
+// CDLOD: place the patch vertex in its node and, towards the end of the node's LOD range, slide every odd vertex
+// onto its even neighbour so the patch matches its parent's resolution where the next level takes over
+vec3 cdlodPosition() {
+    vec2 morphRange = morphRanges[int(aNode.w)];
+    vec2 worldXZ = aNode.xy + aPatch * aNode.z;
+    float distanceToCamera = distance(cameraPosition.xyz, vec3(worldXZ.x, 0.0, worldXZ.y));
+    float morphK = clamp((distanceToCamera - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+
+    vec2 gridPos = aPatch * patchResolution;
+    vec2 oddOffset = fract(gridPos * 0.5) * 2.0;
+    worldXZ = aNode.xy + (gridPos - oddOffset * morphK) / patchResolution * aNode.z;
+    return vec3(worldXZ.x, 0.0, worldXZ.y);
+}
+
+
+// Horizon tiles get coarser with distance; a cascade whose shortest waves are below the tile's Nyquist limit would
+// alias into large false swells, so it fades out as the vertex spacing passes a quarter to half its wavelength
+vec4 horizonCascadeWeights() {
+    float vertexSpacing = aNode.z / patchResolution;
+    vec4 weights = vec4(1.0);
+    for (int c = 0; c < cascadeCount; ++c) {
+        weights[c] = 1.0 - smoothstep(0.25, 0.5, vertexSpacing / cascadeMinWavelength[c]);
+    }
+    return weights;
+}
+
+
 void main() {
-    texCoords = (aPos.xz + size / 2) / size;
-    waveHeight = texture(inputTexture, texCoords).x;
-    vec3 position = vec3(aPos.x, waveHeight, aPos.z);
+    vec3 basePos;
+    if (meshMode == MESH_GRID) {
+        basePos = gridPosition();
+    } else if (meshMode == MESH_PROJECTED) {
+        basePos = projectedPosition();
+    } else {
+        basePos = cdlodPosition();
+    }
+    cascadeWeights = meshMode == MESH_HORIZON ? horizonCascadeWeights() : vec4(1.0);
+    // Repeats every `size`, the oceanFields textures wrap
+    texCoords = (basePos.xz + size / 2) / size;
+    vec2 displacement = vec2(0.0);
+    if (useOceanFields) {
+        // Cascades tile at their own patch size and cover disjoint wavenumber bands, so they simply add up
+        waveHeight = 0.0;
+        for (int c = 0; c < cascadeCount; ++c) {
+            vec2 uv = texCoords * cascadeScale[c];
+            waveHeight += cascadeWeights[c] * texture(oceanFields, vec3(uv, 3 * c)).x;
+            displacement += cascadeWeights[c] * texture(oceanFields, vec3(uv, 3 * c + 1)).xy; // Choppy horizontal displacement
+        }
+    } else {
+        waveHeight = texture(inputTexture, texCoords).x;
+    }
+    vec3 position = vec3(basePos.x + displacement.x, waveHeight, basePos.z + displacement.y);
     gl_Position = projection * view * model * vec4(position, 1.0);
 
-    ecNormal = normalize(mat3(transpose(inverse(view * model))) * computeSurfaceNormal());
+    ecNormal = normalize(normalMatrix * computeSurfaceNormal());
     ecPosition = vec3(view * model * vec4(position, 1.0));
 }
\ No newline at end of file
@@ -1,33 +1,45 @@
 #version 330 core
 
 uniform sampler2D fftTexture;
-uniform float time;
+uniform float time; // Wrapped into [0, OCEAN_REPEAT_TIME)
 uniform int N; // grid size
 uniform float L; // size of the water plane
+#ifdef INCREMENTAL_PHASE
+uniform sampler2D phaseTexture; // advancePhase.frag state; rg = exp(i * omega * t), ba = exp(i * omega * dt)
+uniform float phaseFraction;    // Frame time past t, in steps (< 1)
+#endif
 
 in vec2 texCoords;
 
 out vec4 fragColor;
 
 
-void main() {
-    ivec2 gridPos = ivec2(floor(texCoords * (N - 1)));
-
-    int k_x = (gridPos.x < (N / 2)) ? gridPos.x : gridPos.x - N; // left to right: 0, +ve, -ve
-    int k_y = (gridPos.y < (N / 2)) ? -(gridPos.y + 1) : -(gridPos.y - N + 1); // top to bottom: 0, +ve, -ve
+#include "oceanWave.glsl"
 
-    vec2 k = (2.0 * 3.14159265359 / L) * vec2(float(k_x), float(k_y));
-    float k_mag = length(k);
+void main() {
+#ifdef INCREMENTAL_PHASE
+    // The rotor already holds cos(wt) + isin(wt), advanced without transcendentals and wrapped modulo 2 pi. The
+    // clock only moves in whole steps, so turn it on by the rest of the frame time: an angle below omega * dt,
+    // taken from the step rotor itself, so it is as precise as the steps are.
+    vec4 state = texelFetch(phaseTexture, ivec2(gl_FragCoord.xy), 0);
+    float remainderAngle = atan(state.a, state.b) * phaseFraction;
+    vec2 correction = vec2(cos(remainderAngle), sin(remainderAngle));
+    float cosTerm = state.r * correction.x - state.g * correction.y;
+    float sinTerm = state.r * correction.y + state.g * correction.x;
+#else
+    // The wave vector computeFourier.frag generated this texel's h0 for
+    vec2 k = oceanWaveVector(oceanWaveNumber(ivec2(gl_FragCoord.xy), N), L);
+
+    // exp^(iwt)
+    float omega = oceanDispersion(k);
+    float sinTerm = sin(omega*time);
+    float cosTerm = cos(omega*time);
+#endif
 
-    // Dispersion relation: exp^(iwt), w = sqrt(k_mag * g);
     // (a + ib) * (cos(wt) + isin(wt)) = [a*cos(wt) - b*sin(wt)] + i[a*sin(wt) + b*cos(wt)]
-
-    vec2 fourierAmplitude = texture(fftTexture, texCoords).rg;
+    vec2 fourierAmplitude = texelFetch(fftTexture, ivec2(gl_FragCoord.xy), 0).rg;
     float a = fourierAmplitude.x;
     float b = fourierAmplitude.y;
-    float omega = sqrt(k_mag * 9.81);
-    float sinTerm = sin(omega*time);
-    float cosTerm = cos(omega*time);
 
     fragColor = vec4(a*cosTerm - b*sinTerm, a*sinTerm + b*cosTerm, 0.0, 0.0);
 
@@ -0,0 +1,19 @@
+#version 410 core
+
+#include "frameUniforms.glsl"
+
+// Buffer-less coarse patch mesh for the tessellation mode: patchCount^2 quad patches over the plane, 4 vertices
+// each, drawn as GL_PATCHES. Positions follow from gl_VertexID like the grid mode of shader.vert.
+uniform int patchCount;
+
+out vec3 tcPosition;
+
+void main() {
+    int patchIndex = gl_VertexID / 4;
+    int corner = gl_VertexID % 4;
+    // Corners in order (0, 0), (1, 0), (1, 1), (0, 1), matching gl_TessCoord in waterTess.tese
+    vec2 cornerOffset = vec2(corner == 1 || corner == 2, corner >= 2);
+    vec2 patchPos = vec2(patchIndex % patchCount, patchIndex / patchCount) + cornerOffset;
+    vec2 worldXZ = patchPos / float(patchCount) * size - size / 2;
+    tcPosition = vec3(worldXZ.x, 0.0, worldXZ.y);
+}